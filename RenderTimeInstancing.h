@@ -25,7 +25,22 @@ OR OTHER DEALINGS IN THE SOFTWARE.
 #include <mesh.h>
 #include <containers/array.h>
 
+//standard headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
+
 #define RENDERTIME_INSTANCING_INTERFACE Interface_ID(0x442741c3, 0x2e22675c)
+/*! \brief Answered, with the same pointer, by objects built against this version of the header, see GetExtendedRenderTimeInstancing() */
+#define RENDERTIME_INSTANCING_EXTENDED_INTERFACE Interface_ID(0x442741c3, 0x2e22675d)
+//! \brief The version of the interface in this header, as returned by RenderTimeInstancing::GetInterfaceVersion()
+#define RENDERTIME_INSTANCING_VERSION 2
 
 class Mtl;
     
@@ -38,9 +53,54 @@ namespace MaxSDK
         enum        TypeID;
 
         class  RenderInstanceSource;
+        class  RenderInstanceTarget;
+        class  TargetContext;
         struct MotionBlurInfo;
+        struct ChangeSet;
+        struct TargetChanges;
+        struct UpdateInfo;
+        struct AsyncUpdate;
+        struct InstancingStatistics;
         struct ChannelInfo;
 
+        /*! \brief Defines which calls an object allows from several threads at the same time.
+        \see RenderTimeInstancing::GetThreadingFlags() */
+        enum ThreadingFlags : signed int
+        {
+            th_none              = 0,      //!< \brief Only the per-thread target iteration described on RenderTimeInstancing (default)
+            th_concurrentSources = 1 << 0, //!< \brief Different sources may be accessed concurrently, including RenderInstanceSource::GetData()
+        };
+
+        /*! \brief Defines which optional functions an object implements natively.
+
+        Every optional function has a default implementation built on the basic interface, so a flag that
+        is not set does not mean the function cannot be called, only that it is no faster than the renderer
+        doing the equivalent work itself.
+        \see RenderTimeInstancing::GetCapabilities() */
+        enum Capabilities : signed int
+        {
+            cap_none             = 0,
+            cap_batchTMs         = 1 << 0,  //!< \brief RenderInstanceSource::GetTMsBatch(), GetTMsBatchSoA() and GetTMsCompact()
+            cap_motionBatch      = 1 << 1,  //!< \brief RenderInstanceSource::GetMotionBatch() and GetMotionBatchSoA()
+            cap_channelViews     = 1 << 2,  //!< \brief RenderInstanceSource::GetChannelView() or GetTargetRecords() return direct access
+            cap_overrideViews    = 1 << 3,  //!< \brief RenderInstanceTarget::GetMatIDsView() and GetUVWsView() do not copy
+            cap_overrideSets     = 1 << 4,  //!< \brief RenderInstanceSource::GetOverrideSets() returns a stored table
+            cap_prefetch         = 1 << 5,  //!< \brief RenderInstanceSource::PrefetchTargets() does useful work
+            cap_targetContext    = 1 << 6,  //!< \brief RenderInstanceSource::GetRenderInstanceTargetInContext()
+            cap_streaming        = 1 << 7,  //!< \brief UpdateInfo::uf_streaming and RenderInstanceSource::AcquireTargetChunk()
+            cap_culling          = 1 << 8,  //!< \brief UpdateInfo::uf_frustumCulling, uf_distanceLOD and uf_multiView
+            cap_spatialOrder     = 1 << 9,  //!< \brief UpdateInfo::uf_spatialOrder
+            cap_async            = 1 << 10, //!< \brief RenderTimeInstancing::BeginUpdateInstanceData() runs in the background
+            cap_retain           = 1 << 11, //!< \brief RenderTimeInstancing::RetainInstanceData()
+            cap_changes          = 1 << 12, //!< \brief RenderTimeInstancing::GetChanges(), RenderInstanceSource::GetGeneration() and GetTargetChanges()
+            cap_contentHash      = 1 << 13, //!< \brief RenderInstanceSource::GetContentHash()
+            cap_metadata         = 1 << 14, //!< \brief RenderInstanceSource::GetMetadata(), GetLocalBounds() and GetWorldBoundsBatch()
+            cap_borrowedData     = 1 << 15, //!< \brief Some sources return df_borrowed data
+            cap_vertexVelocities = 1 << 16, //!< \brief RenderInstanceSource::GetVertexVelocities()
+            cap_statistics       = 1 << 17, //!< \brief RenderTimeInstancing::GetStatistics()
+            cap_fidelity         = 1 << 18, //!< \brief UpdateInfo::uf_fidelity
+        };
+
         /*! \brief The RenderTimeInstancing interface allows you to access instancing information for an object
                   render time, so that a renderer can do efficient instancing of one or more source objects 
                   at render time. This interface is implemented by an object, and called by a renderer.
@@ -51,6 +111,33 @@ namespace MaxSDK
                   the memory returned from GetRenderInstanceTarget() to improve performance, as long
                   as that memory block is kept separete <em>per thread</em>.
 
+            \note For parallel traversal of the targets of a source, prefer TargetRange or ForEachTargetRange().
+                  These hand each worker thread a contiguous range of targets that it iterates one at a time,
+                  which by construction follows the rule above. For sources of an instancer obtained with
+                  GetExtendedRenderTimeInstancing(), they also let the object prefetch the range through
+                  RenderInstanceSource::PrefetchTargets().
+
+            \note The rule above does not apply to targets retrieved through a TargetContext, see
+                  RenderInstanceSource::GetRenderInstanceTargetInContext(). Each context holds
+                  its own target, so a thread may hold one target per context it owns.
+
+            \note Other calls, such as RenderInstanceSource::GetData(), must be serialized unless the object
+                  reports th_concurrentSources from GetThreadingFlags(), in which case different sources may be
+                  materialized in parallel, for example with ForEachSource(). Objects without the extended
+                  functions cannot report it, so their calls must always be serialized.
+
+            \note The functions of the original interface keep their vtable slots: in RenderTimeInstancing,
+                  RenderInstanceSource and RenderInstanceTarget, every function added since is declared after the
+                  last original one, and none overloads an original one. Any renderer may therefore call the original
+                  functions through RENDERTIME_INSTANCING_INTERFACE, on objects built against any version of this header.
+                  Objects built against an older version do not have the added functions. Renderers must obtain the
+                  interface with GetExtendedRenderTimeInstancing() before using any of them, on the instancer or on its
+                  sources and targets, and otherwise use only the original functions. Objects built against this header
+                  must answer both RENDERTIME_INSTANCING_INTERFACE and RENDERTIME_INSTANCING_EXTENDED_INTERFACE in their
+                  GetInterface(), with the same pointer. New functions must likewise only ever be appended. Structs passed
+                  to the original functions, such as MotionBlurInfo, keep their original layout, since an older renderer
+                  allocates them. New requests go into UpdateInfo, which only reaches UpdateInstanceDataEx().
+
             A renderer should not call GetRenderMesh() for an object that supports this interface. For an object
             that <em>implements</em> this interface, GetRenderMesh() should ideally be implemented and return an aggregate
             mesh of all instances, such that a renderer that does <em>not</em> support this interface at least will
@@ -93,6 +180,7 @@ namespace MaxSDK
 
                     if (flags & DataFlags::mesh)  { ... the pointer is a mesh .... }
                     if (flags & DataFlags::inode) { ... the data pointer is an iNode .... }
+                    if (flags & DataFlags::instancer) { ... the data pointer is a nested RenderTimeInstancing .... }
 
                     // A source acts as a container of targets
                     for (auto target : *source )
@@ -129,6 +217,8 @@ namespace MaxSDK
 
                     if (flags & DataFlags::mesh &&  flags DataFlags::pluginMustDelete)
                                 ... delete the mesh ....
+                    if (flags & DataFlags::borrowed)
+                        source->ReleaseData(data);
 
                 }
                 // Cleanup, if any is needed
@@ -162,7 +252,8 @@ namespace MaxSDK
 
             @param view
                 The view. This allows the object to do level-of-detail computation or do
-                camera frustum culling.
+                camera frustum culling. For explicit, renderer defined culling and level-of-detail,
+                use UpdateInstanceDataEx().
 
             @param plugin
                 The plugin argument of this function takes the name of the plugin
@@ -202,6 +293,16 @@ namespace MaxSDK
             /*! \brief Get the n:th source */
             virtual RenderInstanceSource  *GetRenderInstanceSource(size_t index) = 0;
 
+            /*! \brief Get which calls may be made from several threads at the same time.
+
+            With th_concurrentSources, any function of different RenderInstanceSource objects may be called
+            concurrently, one thread per source, so a renderer can convert many source meshes in parallel.
+            GetRenderInstanceSource() and GetNumInstanceSources() may then also be called concurrently.
+            The default implementation returns th_none.
+            \see Enum ThreadingFlags
+            */
+            virtual ThreadingFlags         GetThreadingFlags() { return th_none; }
+
             //! \brief For convenicence - iterator
             class Iterator;
             //! \brief Retreive the begin() iterator. Allows using a for (auto x : y) loop
@@ -221,6 +322,126 @@ namespace MaxSDK
                 RenderTimeInstancing  *m_item;
             };
             ///@}
+
+            /*! \name Extended update */
+            ///@{
+            /*! \brief Make sure instancing data is up-to-date, with renderer-supplied culling and level-of-detail.
+
+            Same as UpdateInstanceData(), but additionally takes an UpdateInfo, which like the MotionBlurInfo
+            is a two way communication between the renderer and the object. The renderer fills in the
+            requests it wants honored (for example its own culling frustum or a distance based LOD table),
+            and upon return the object has cleared the flags of any request it did <em>not</em> honor, and
+            filled in the statistics fields.
+
+            Targets that an object culls are never generated, so they do not appear in
+            RenderInstanceSource::GetNumInstanceTargets() at all.
+
+            The default implementation ignores all requests, clears UpdateInfo::flags, reports Matrix3
+            transforms and a varying number of samples, and calls UpdateInstanceData().
+
+            \see Struct UpdateInfo
+            */
+            virtual void UpdateInstanceDataEx(TimeValue t, Interval &valid, MotionBlurInfo &mbinfo, UpdateInfo &updinfo, View &view, TSTR plugin);
+
+            /*! \brief Keep the instancing data of the last update for another time.
+
+            Instead of calling ReleaseInstanceData() and UpdateInstanceData() for each frame, a renderer
+            rendering a sequence can call this first. If it returns true, the object kept all its sources
+            and targets alive, unchanged, and they are valid at time <em>t</em>. The renderer can then keep
+            using what it translated from them, including pointers returned by RenderInstanceSource::GetData(),
+            and skip the update entirely. If it returns false, nothing changed, and the renderer proceeds
+            with ReleaseInstanceData() and UpdateInstanceData() as usual.
+
+            An object must only return true if re-evaluating at <em>t</em> would give the same results,
+            which is always the case for times inside the <em>valid</em> interval of the last update.
+
+            @param t The new time.
+            @param valid Returns the validity of the retained data, which may be wider than what the
+                   last UpdateInstanceData() returned.
+            @return true if the data was retained. The default implementation returns false.
+            */
+            virtual bool RetainInstanceData(TimeValue t, Interval &valid) { return false; }
+
+            /*! \brief Get what changed in the last call to UpdateInstanceData().
+
+            Interactive renderers can use this to patch their translated data instead of rebuilding
+            it after every UpdateInstanceData(). The changes are relative to the previous call to
+            UpdateInstanceData() made by the same renderer. Each RenderInstanceSource also
+            has a generation counter, see RenderInstanceSource::GetGeneration().
+
+            @param changes Receives the change set.
+            @return true if the change set is filled in. false if the object does not track changes,
+                    in which case everything should be treated as changed. The default
+                    implementation returns false.
+
+            \see Struct ChangeSet
+            */
+            virtual bool GetChanges(ChangeSet &changes) { return false; }
+
+            /*! \brief Start updating the instancing data asynchronously.
+
+            Same as UpdateInstanceDataEx(), but allows the object to evaluate in the background, so the renderer
+            can translate the rest of the scene, or update several instancers, at the same time. The results
+            (the validity interval, MotionBlurInfo and UpdateInfo responses) are written into <em>request</em>,
+            and AsyncUpdate::onComplete is called once they are available.
+
+            The <em>request</em>, including the View it points to, must stay alive until the update is complete.
+            Until then, the renderer may not call any other function on this object except IsUpdateComplete() and
+            WaitForUpdate().
+
+            The default implementation updates synchronously, i.e. the update is complete (and onComplete has
+            been called) when this returns.
+
+            \see Struct AsyncUpdate
+            */
+            virtual void BeginUpdateInstanceData(AsyncUpdate &request);
+
+            /*! \brief Returns true if no update started with BeginUpdateInstanceData() is running. Does not block. */
+            virtual bool IsUpdateComplete() { return true; }
+
+            /*! \brief Block until the update started with BeginUpdateInstanceData() is complete.
+            Returns immediately if no update is running. */
+            virtual void WaitForUpdate() {}
+            ///@}
+
+            /*! \name Version and capabilities
+                These functions may only be called on interfaces obtained with GetExtendedRenderTimeInstancing(). */
+            ///@{
+            /*! \brief Get the version of this header the object was built against.
+            Returns RENDERTIME_INSTANCING_VERSION as defined when the object was compiled. */
+            virtual int GetInterfaceVersion() { return RENDERTIME_INSTANCING_VERSION; }
+
+            /*! \brief Get which optional functions the object implements natively.
+
+            Intended to be queried once, right after obtaining the interface, so a renderer can choose the
+            fastest path for its translation. The default implementation returns cap_none.
+            \see Enum Capabilities
+            */
+            virtual Capabilities GetCapabilities() { return cap_none; }
+            ///@}
+
+            /*! \name Statistics
+                These functions allow attributing translation time and memory to the object or the renderer. */
+            ///@{
+            /*! \brief Get the statistics of the object.
+
+            The object fills in the fields it measured during its work: typically the time spent in
+            UpdateInstanceData(), building data in RenderInstanceSource::GetData() and in ReleaseInstanceData(),
+            the memory it allocated for targets, meshes and channels, and the number of targets emitted and culled.
+            Fields the object did not measure are left untouched, so a renderer can zero the struct first.
+
+            @return true if any statistics were filled in. The default implementation returns false.
+            \see Struct InstancingStatistics
+            */
+            virtual bool GetStatistics(InstancingStatistics &stats) { return false; }
+
+            /*! \brief Tell the object the statistics measured by the renderer.
+
+            The renderer reports what it measured on its side, for example the time spent iterating targets,
+            so the object can log or display the complete picture. The default implementation does nothing.
+            */
+            virtual void ReportStatistics(const InstancingStatistics &stats) {}
+            ///@}
         };
 
         /*! \brief Motion Blur information struct.
@@ -250,6 +471,428 @@ namespace MaxSDK
             };
         };
 
+        /*! \brief A plane used for culling. A point <em>p</em> is inside when DotProd(normal, p) + offset >= 0. */
+        struct CullingPlane {
+            Point3 normal; //!< \brief The plane normal, pointing towards the inside. World space.
+            float  offset; //!< \brief The plane offset
+        };
+
+        /*! \brief A level-of-detail step. Targets further away than <em>distance</em> are kept at <em>density</em>. */
+        struct LODLevel {
+            float distance; //!< \brief Distance from UpdateInfo::cameraPos, in world units
+            float density;  //!< \brief Fraction of targets to keep beyond this distance, between 0.0 and 1.0
+        };
+
+        /*! \brief One of several views evaluated by a single update, see UpdateInfo::uf_multiView */
+        struct ViewRequest {
+            MaxSDK::Array<CullingPlane> frustum;         //!< \brief The culling volume of this view, as in UpdateInfo::frustum
+            Point3                      cameraPos;       //!< \brief The camera position of this view, for level-of-detail
+
+            ViewRequest() : cameraPos(0.0f, 0.0f, 0.0f) {}
+        };
+
+        /*! \brief Update request information.
+
+        This communicates culling, level-of-detail and other evaluation requests from the renderer to the
+        object, and the results back to the renderer. It is filled in and passed to RenderTimeInstancing::UpdateInstanceDataEx()
+        by the renderer, and the object clears the flags of any request it did not honor, so the renderer
+        knows whether it needs to do the culling itself.
+        */
+        struct UpdateInfo {
+            /*! \brief Defines which requests are made in UpdateInfo */
+            enum UpdateFlags : signed int
+            {
+                uf_none           = 0,      //!< \brief No requests (default)
+                uf_frustumCulling = 1 << 0, //!< \brief Only generate targets whose bounds intersect <em>frustum</em>
+                uf_distanceLOD    = 1 << 1, //!< \brief Thin out targets with distance from <em>cameraPos</em>, according to <em>lodLevels</em>
+                uf_streaming      = 1 << 2, //!< \brief Produce targets on demand in chunks, see RenderInstanceSource::AcquireTargetChunk()
+                uf_spatialOrder   = 1 << 3, //!< \brief Return the targets of each source sorted in space, according to <em>targetOrder</em>
+                uf_multiView      = 1 << 4, //!< \brief Cull against several <em>views</em> at once, see RenderInstanceTarget::GetVisibilityMask()
+                uf_fidelity       = 1 << 5, //!< \brief Reduced fidelity for interactive preview, according to <em>targetFraction</em> and <em>proxyMode</em>
+            };
+            /*! \brief Defines the orders available for uf_spatialOrder */
+            enum TargetOrder : signed int
+            {
+                to_unordered = 0, //!< \brief Any order (default)
+                to_morton    = 1, //!< \brief Morton (Z-order) of the target positions, see MortonKey()
+                to_hilbert   = 2, //!< \brief Hilbert order of the target positions, see HilbertKey(). Better locality, slower to compute.
+            };
+            /*! \brief Defines the source data wanted with uf_fidelity */
+            enum ProxyMode : signed int
+            {
+                pm_full        = 0, //!< \brief Full resolution source data (default)
+                pm_decimated   = 1, //!< \brief Reduced resolution meshes
+                pm_boundingBox = 2, //!< \brief A box mesh matching the bounds of each source
+                pm_points      = 3, //!< \brief No geometry, the renderer only draws the target positions. GetData() may return nullptr.
+            };
+            /*! \brief Defines the transform formats RenderInstanceSource::GetTMsCompact() can write */
+            enum TMFormat : signed int
+            {
+                tmf_matrix3   = 0, //!< \brief Matrix3 (default)
+                tmf_float3x4  = 1, //!< \brief TMFloat3x4, a 3x4 row-major float matrix
+                tmf_trs       = 2, //!< \brief TMTRS, translation + quaternion + scale
+                tmf_quantized = 3, //!< \brief TMQuantized, 16-bit translation relative to a range box, 16-bit quaternion and uniform scale
+            };
+            /*! \brief The requests. Upon return, only the flags that the object honored remain set.
+            \see Enum UpdateFlags */
+            UpdateFlags flags;
+
+            /*! \brief The culling volume, as a set of planes. All planes must be passed for a target to be kept.
+            This need not be the camera frustum, it can for example be padded for reflections. */
+            MaxSDK::Array<CullingPlane> frustum;
+            /*! \brief Extra distance, in world units, that target bounds may be outside of the frustum and still be kept */
+            float cullPadding;
+            /*! \brief The position the level-of-detail distances are measured from, in world space */
+            Point3 cameraPos;
+            /*! \brief The level-of-detail table, sorted by increasing distance */
+            MaxSDK::Array<LODLevel> lodLevels;
+            /*! \brief For uf_streaming - the preferred number of targets per chunk. The object may use a different
+            size, which it returns here. The renderer should hold as few chunks as possible at the same time. */
+            size_t streamChunkSize;
+            /*! \brief For uf_spatialOrder - the order of the targets within each source. The targets are sorted
+            by the translation part of their first transform, over the bounds of all targets of the source. */
+            TargetOrder targetOrder;
+            /*! \brief For uf_multiView - up to 64 views, whose index is the bit in RenderInstanceTarget::GetVisibilityMask().
+            A target is generated if it is visible in any of them, and level-of-detail uses the closest camera.
+            <em>frustum</em> and <em>cameraPos</em> are ignored. */
+            MaxSDK::Array<ViewRequest> views;
+            /*! \brief For uf_fidelity - the fraction of targets to generate, between 0.0 and 1.0. The subset should
+            be stable across updates, so an interactive refresh does not flicker, see KeepTarget(). */
+            float targetFraction;
+            /*! \brief For uf_fidelity - the kind of source data wanted. Sources returning reduced data set df_proxy. */
+            ProxyMode proxyMode;
+            /*! \brief The preferred transform format.
+            The renderer sets the format it wants to store transforms in. Upon return, the object has set it
+            to the format it stores natively, which RenderInstanceSource::GetTMsCompact() can write with no
+            conversion. Any format can be requested from GetTMsCompact(), but other formats are converted.
+            \see Enum TMFormat */
+            TMFormat tmFormat;
+            /*! \brief The number of transforms per moving instance returned by RenderInstanceTarget::GetTMs().
+            The renderer sets the number of samples it wants, or 0 to let the object choose. Upon return, the
+            object has set it to the number of samples it actually returns for moving instances, or 0 if this
+            varies. Static instances always return a single transform, see RenderInstanceTarget::IsStatic(). */
+            int numSamples;
+
+            size_t numEmitted; //!< \brief Returned by the object - the number of targets generated, or 0 if unknown
+            size_t numCulled;  //!< \brief Returned by the object - the number of targets culled or thinned out, or 0 if unknown
+
+            UpdateInfo(UpdateFlags f = uf_none)
+                : flags(f), cullPadding(0.0f), cameraPos(0.0f, 0.0f, 0.0f), streamChunkSize(65536), targetOrder(to_unordered), targetFraction(1.0f), proxyMode(pm_full),
+                  tmFormat(tmf_matrix3), numSamples(0), numEmitted(0), numCulled(0) {}
+
+            /*! \brief Utility for objects - test whether a world space bounding box is culled by <em>frustum</em>,
+            or with uf_multiView, by all <em>views</em> */
+            bool IsCulled(const Box3 &worldBox) const
+            {
+                if (!(flags & uf_frustumCulling))
+                    return false;
+                if (flags & uf_multiView)
+                    return GetVisibilityMask(worldBox) == 0;
+                return IsOutside(frustum, worldBox);
+            }
+
+            /*! \brief Utility for objects - get the mask of <em>views</em> in which a world space bounding box is visible.
+            Returns all ones unless both uf_frustumCulling and uf_multiView are set. */
+            unsigned __int64 GetVisibilityMask(const Box3 &worldBox) const
+            {
+                if (!(flags & uf_frustumCulling) || !(flags & uf_multiView))
+                    return ~0ULL;
+                unsigned __int64 mask = 0;
+                for (size_t v = 0; v < views.length() && v < 64; v++)
+                    if (!IsOutside(views[v].frustum, worldBox))
+                        mask |= 1ULL << v;
+                return mask;
+            }
+
+            /*! \brief Utility for objects - get the fraction of targets to keep at a world space position */
+            float GetLODDensity(const Point3 &pos) const
+            {
+                if (!(flags & uf_distanceLOD))
+                    return 1.0f;
+                float distance = (pos - cameraPos).Length();
+                if ((flags & uf_multiView) && !views.isEmpty())
+                {
+                    distance = (pos - views[0].cameraPos).Length();
+                    for (size_t v = 1; v < views.length(); v++)
+                        distance = std::min(distance, (pos - views[v].cameraPos).Length());
+                }
+                float density  = 1.0f;
+                for (size_t i = 0; i < lodLevels.length() && distance > lodLevels[i].distance; i++)
+                    density = lodLevels[i].density;
+                return density;
+            }
+
+            /*! \brief Utility for objects - decide whether to keep a target, given its GetID() and a density.
+
+            Keeps a stable pseudo-random subset of the targets: the fraction <em>density</em>, further scaled by
+            <em>targetFraction</em> with uf_fidelity. A target kept at some density is also kept at any higher one.
+            */
+            bool KeepTarget(__int64 id, float density = 1.0f) const
+            {
+                if (flags & uf_fidelity)
+                    density *= targetFraction;
+                if (density >= 1.0f)
+                    return true;
+                // splitmix64 finalizer, so consecutive IDs are spread evenly
+                unsigned __int64 x = (unsigned __int64)id + 0x9e3779b97f4a7c15ULL;
+                x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+                x =  x ^ (x >> 31);
+                return (float)(x >> 40) * (1.0f / 16777216.0f) < density;
+            }
+
+        private:
+            bool IsOutside(const MaxSDK::Array<CullingPlane> &planes, const Box3 &worldBox) const
+            {
+                for (size_t i = 0; i < planes.length(); i++)
+                {
+                    const CullingPlane &plane = planes[i];
+                    // The box corner furthest along the plane normal
+                    Point3 p(plane.normal.x >= 0.0f ? worldBox.pmax.x : worldBox.pmin.x,
+                             plane.normal.y >= 0.0f ? worldBox.pmax.y : worldBox.pmin.y,
+                             plane.normal.z >= 0.0f ? worldBox.pmax.z : worldBox.pmin.z);
+                    if (DotProd(plane.normal, p) + plane.offset < -cullPadding * plane.normal.Length())
+                        return true;
+                }
+                return false;
+            }
+        };
+
+        /*! \brief Quantize a position to 21 bits per axis over a bounding box. Positions outside are clamped. */
+        inline void QuantizePosition(const Point3 &pos, const Box3 &bounds, unsigned int q[3])
+        {
+            const float scale = (float)((1 << 21) - 1);
+            for (int i = 0; i < 3; i++)
+            {
+                float extent = bounds.pmax[i] - bounds.pmin[i];
+                float f      = extent > 0.0f ? (pos[i] - bounds.pmin[i]) / extent : 0.0f;
+                f            = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+                q[i]         = (unsigned int)(f * scale + 0.5f);
+            }
+        }
+
+        /*! \brief Spread the low 21 bits of a value so there are two zero bits between each of them */
+        inline unsigned __int64 SpreadBits3(unsigned int v)
+        {
+            unsigned __int64 x = v & 0x1fffff;
+            x = (x | x << 32) & 0x001f00000000ffffULL;
+            x = (x | x << 16) & 0x001f0000ff0000ffULL;
+            x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+            x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+            x = (x | x << 2)  & 0x1249249249249249ULL;
+            return x;
+        }
+
+        /*! \brief Get the 63 bit Morton (Z-order) key of a position within a bounding box */
+        inline unsigned __int64 MortonKey(const Point3 &pos, const Box3 &bounds)
+        {
+            unsigned int q[3];
+            QuantizePosition(pos, bounds, q);
+            return (SpreadBits3(q[0]) << 2) | (SpreadBits3(q[1]) << 1) | SpreadBits3(q[2]);
+        }
+
+        /*! \brief Get the 63 bit Hilbert curve key of a position within a bounding box */
+        inline unsigned __int64 HilbertKey(const Point3 &pos, const Box3 &bounds)
+        {
+            unsigned int x[3];
+            QuantizePosition(pos, bounds, x);
+
+            // Convert the axes to the transposed Hilbert index (J. Skilling, "Programming the Hilbert curve")
+            const unsigned int m = 1u << 20;
+            for (unsigned int q = m; q > 1; q >>= 1)
+            {
+                unsigned int p = q - 1;
+                for (int i = 0; i < 3; i++)
+                {
+                    if (x[i] & q)
+                        x[0] ^= p;
+                    else
+                    {
+                        unsigned int t = (x[0] ^ x[i]) & p;
+                        x[0] ^= t;
+                        x[i] ^= t;
+                    }
+                }
+            }
+            x[1] ^= x[0];
+            x[2] ^= x[1];
+            unsigned int t = 0;
+            for (unsigned int q = m; q > 1; q >>= 1)
+                if (x[2] & q)
+                    t ^= q - 1;
+            for (int i = 0; i < 3; i++)
+                x[i] ^= t;
+
+            return (SpreadBits3(x[0]) << 2) | (SpreadBits3(x[1]) << 1) | SpreadBits3(x[2]);
+        }
+
+        /*! \brief Utility for objects - compute the permutation that sorts positions in the given order.
+
+        On return, <em>indices</em> holds the indices of the <em>count</em> positions in sorted order. Positions
+        with equal keys keep their original relative order. With UpdateInfo::to_unordered the identity is returned.
+        */
+        inline void ComputeSpatialOrder(const Point3 *positions, size_t count, const Box3 &bounds, UpdateInfo::TargetOrder order, size_t *indices)
+        {
+            if (order == UpdateInfo::to_unordered)
+            {
+                for (size_t i = 0; i < count; i++)
+                    indices[i] = i;
+                return;
+            }
+
+            std::vector<std::pair<unsigned __int64, size_t>> keys(count);
+            for (size_t i = 0; i < count; i++)
+                keys[i] = std::make_pair(order == UpdateInfo::to_hilbert ? HilbertKey(positions[i], bounds) : MortonKey(positions[i], bounds), i);
+            std::sort(keys.begin(), keys.end());
+            for (size_t i = 0; i < count; i++)
+                indices[i] = keys[i].second;
+        }
+
+        /*! \brief An asynchronous update request, passed to RenderTimeInstancing::BeginUpdateInstanceData().
+
+        The renderer fills in the same arguments it would pass to RenderTimeInstancing::UpdateInstanceDataEx(), and
+        the object writes its responses into <em>valid</em>, <em>mbinfo</em> and <em>updinfo</em> before calling
+        <em>onComplete</em>. The request must stay alive until then.
+        */
+        struct AsyncUpdate {
+            TimeValue      t;       //!< \brief The time of the evaluation
+            Interval       valid;   //!< \brief Returns the validity of the data
+            MotionBlurInfo mbinfo;  //!< \brief The motion blur request and response
+            UpdateInfo     updinfo; //!< \brief The update request and response
+            View          *view;    //!< \brief The view. Must stay valid until the update is complete.
+            TSTR           plugin;  //!< \brief The name of the calling plugin, in lowercase letters
+
+            /*! \brief Called by the object once the update is complete, possibly from another thread.
+            May be empty. It must not call back into the object, other than to read the instancing data. */
+            std::function<void(AsyncUpdate &request)> onComplete;
+
+            AsyncUpdate() : t(0), valid(FOREVER), view(nullptr) {}
+        };
+
+        /*! \brief Per-phase timing and memory counters.
+
+        Filled in by the object in RenderTimeInstancing::GetStatistics(), and by the renderer for
+        RenderTimeInstancing::ReportStatistics(). ScopedPhaseTimer can be used to measure the phases.
+        */
+        struct InstancingStatistics {
+            /*! \brief The phases of using the interface */
+            enum Phase : int
+            {
+                ph_update    = 0, //!< \brief RenderTimeInstancing::UpdateInstanceData()
+                ph_getData   = 1, //!< \brief RenderInstanceSource::GetData(), i.e. building meshes
+                ph_iteration = 2, //!< \brief Iterating the targets and reading their data
+                ph_release   = 3, //!< \brief RenderTimeInstancing::ReleaseInstanceData()
+                ph_count     = 4
+            };
+
+            double seconds[ph_count]; //!< \brief Wall time spent in each phase
+            size_t targetBytes;       //!< \brief Bytes allocated for targets
+            size_t meshBytes;         //!< \brief Bytes allocated for source data (meshes)
+            size_t channelBytes;      //!< \brief Bytes allocated for custom channel data
+            size_t numEmitted;        //!< \brief Number of targets emitted
+            size_t numCulled;         //!< \brief Number of targets culled or thinned out
+
+            InstancingStatistics() { Reset(); }
+
+            void Reset()
+            {
+                for (int i = 0; i < ph_count; i++)
+                    seconds[i] = 0.0;
+                targetBytes = meshBytes = channelBytes = 0;
+                numEmitted  = numCulled = 0;
+            }
+
+            //! \brief Accumulate other statistics, for example those measured by another thread
+            void Add(const InstancingStatistics &other)
+            {
+                for (int i = 0; i < ph_count; i++)
+                    seconds[i] += other.seconds[i];
+                targetBytes  += other.targetBytes;
+                meshBytes    += other.meshBytes;
+                channelBytes += other.channelBytes;
+                numEmitted   += other.numEmitted;
+                numCulled    += other.numCulled;
+            }
+        };
+
+        /*! \brief Adds the wall time of its scope to a phase of an InstancingStatistics.
+
+        Not thread safe: threads should each measure into their own InstancingStatistics and combine
+        them with InstancingStatistics::Add().
+        \code
+        {
+            ScopedPhaseTimer timer(stats, InstancingStatistics::ph_update);
+            instancer->UpdateInstanceData(t, valid, mblur, view, _T("myPlugin"));
+        }
+        \endcode
+        */
+        class ScopedPhaseTimer {
+        public:
+            ScopedPhaseTimer(InstancingStatistics &stats, InstancingStatistics::Phase phase)
+                : m_stats(stats), m_phase(phase), m_start(std::chrono::steady_clock::now()) {}
+            ~ScopedPhaseTimer()
+            {
+                m_stats.seconds[m_phase] += std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+            }
+
+            ScopedPhaseTimer(const ScopedPhaseTimer&)            = delete;
+            ScopedPhaseTimer &operator=(const ScopedPhaseTimer&) = delete;
+
+        private:
+            InstancingStatistics                 &m_stats;
+            InstancingStatistics::Phase           m_phase;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        /*! \brief Describes the changes made by the last RenderTimeInstancing::UpdateInstanceData().
+
+        Indices in <em>added</em> and <em>modified</em> refer to the sources after the update, indices in
+        <em>removed</em> refer to the sources before it. Sources that were neither added nor removed keep
+        their relative order, so the previous source list with <em>removed</em> taken out matches the
+        new list with <em>added</em> taken out. Sources in none of the lists are unchanged.
+
+        Returned by RenderTimeInstancing::GetChanges().
+        */
+        struct ChangeSet {
+            /*! \brief Defines what has changed on a modified source */
+            enum ChangeFlags : signed int
+            {
+                ch_none       = 0,
+                ch_transforms = 1 << 0, //!< \brief Only the transforms (and velocity/spin) of existing targets changed
+                ch_targets    = 1 << 1, //!< \brief Targets were added or removed
+                ch_channels   = 1 << 2, //!< \brief Custom data channel values changed
+                ch_overrides  = 1 << 3, //!< \brief Material, material ID or UVW overrides changed
+                ch_data       = 1 << 4, //!< \brief The data returned by RenderInstanceSource::GetData() changed (topology, mesh, node)
+
+                ch_all        = ch_transforms | ch_targets | ch_channels | ch_overrides | ch_data
+            };
+
+            /*! \brief A modified source */
+            struct SourceChange {
+                size_t      index; //!< \brief Index of the source after the update
+                ChangeFlags flags; //!< \brief What changed on it
+            };
+
+            MaxSDK::Array<size_t>       added;    //!< \brief Sources that are new
+            MaxSDK::Array<size_t>       removed;  //!< \brief Sources that no longer exist
+            MaxSDK::Array<SourceChange> modified; //!< \brief Sources that changed, and in what way
+        };
+
+        /*! \brief Describes which targets of a source changed in the last RenderTimeInstancing::UpdateInstanceData().
+
+        Targets are matched between updates by RenderInstanceTarget::GetID(), so their indices may change freely.
+        Indices in <em>moved</em> and <em>added</em> refer to the targets after the update. Targets that existed
+        before the update and are in neither <em>moved</em> nor <em>removed</em> are unchanged, though their index
+        may differ.
+
+        Returned by RenderInstanceSource::GetTargetChanges().
+        */
+        struct TargetChanges {
+            MaxSDK::Array<size_t>  moved;   //!< \brief Existing targets whose transforms, velocity or spin changed
+            MaxSDK::Array<size_t>  added;   //!< \brief Targets whose ID did not exist before
+            MaxSDK::Array<__int64> removed; //!< \brief IDs of targets that no longer exist
+        };
+
         /*! \brief UVW channel override data. This will override all the UV coordinates of given map channel on a mesh with a set value. */
         struct InstanceUVWInfo { 
             int channel;    /*!< \brief The map channel to override */
@@ -288,10 +931,292 @@ namespace MaxSDK
 
             df_mesh  = 1 << 0, //!< \brief RenderInstanceSource::GetData() is Mesh*
             df_inode = 1 << 1, //!< \brief RenderInstanceSource::GetData() is INode*
+            df_instancer = 1 << 2, //!< \brief RenderInstanceSource::GetData() is RenderTimeInstancing*, i.e. a nested instancer
 
+            df_proxy            = 1 << 29, //!< \brief Set if the data is a reduced fidelity proxy, see UpdateInfo::uf_fidelity
+            df_borrowed         = 1 << 30, //!< \brief Set if the data is owned by the object, and each GetData() must be matched by a RenderInstanceSource::ReleaseData()
             df_pluginMustDelete = 1 << 31 //!< \brief Set if the renderer is expected to delete the data pointer after use
         };
 
+        /*! \brief Defines which kinds of per-instance overrides the targets of a source may have.
+        \see RenderInstanceSource::GetOverrideFlags() */
+        enum OverrideFlags : signed int
+        {
+            of_none   = 0,      //!< \brief No target has any overrides
+            of_mtl    = 1 << 0, //!< \brief Some targets may return a non-NULL RenderInstanceTarget::GetMtl()
+            of_matIDs = 1 << 1, //!< \brief Some targets may return material ID overrides
+            of_uvws   = 1 << 2, //!< \brief Some targets may return UVW overrides
+
+            of_all    = of_mtl | of_matIDs | of_uvws
+        };
+
+        /*! \brief A non-owning (pointer, count) view of an array of values.
+
+        Returned by functions that avoid allocating a MaxSDK::Array. The lifetime of the
+        data is defined by the function returning the view. */
+        template <typename T>
+        struct ArrayView {
+            const T *data;  //!< \brief Pointer to the first element, or nullptr if empty
+            size_t   count; //!< \brief Number of elements
+
+            ArrayView(const T *d = nullptr, size_t c = 0) : data(d), count(c) {}
+
+            bool     empty() const { return count == 0; }
+            const T *begin() const { return data; }
+            const T *end()   const { return data + count; }
+            const T &operator[](size_t i) const { return data[i]; }
+        };
+
+        /*! \brief A 128-bit content hash identifying the data of a RenderInstanceSource.
+
+        Two sources with equal hashes have identical data with overwhelming probability, across frames,
+        scenes and machines, so the hash can be used as the key of a persistent geometry cache. The hash is
+        not cryptographic and not collision resistant: do not rely on it for data that may be crafted to
+        collide, such as cache files from untrusted sources.
+        \see RenderInstanceSource::GetContentHash() */
+        struct ContentHash {
+            unsigned __int64 lo; //!< \brief Low 64 bits
+            unsigned __int64 hi; //!< \brief High 64 bits
+
+            ContentHash(unsigned __int64 l = 0, unsigned __int64 h = 0) : lo(l), hi(h) {}
+
+            bool IsNull()                           const { return lo == 0 && hi == 0; }
+            bool operator==(const ContentHash &rhs) const { return lo == rhs.lo && hi == rhs.hi; }
+            bool operator!=(const ContentHash &rhs) const { return !(*this == rhs); }
+            bool operator< (const ContentHash &rhs) const { return hi < rhs.hi || (hi == rhs.hi && lo < rhs.lo); }
+
+            /*! \brief Mix <em>size</em> bytes into the hash.
+            This is a simple, platform independent 2x64 bit FNV-1a style hash. It is fast, but not
+            cryptographically secure. */
+            void Add(const void *data, size_t size)
+            {
+                const unsigned char *bytes = (const unsigned char*)data;
+                const unsigned __int64 prime = 0x100000001b3ULL;
+                if (IsNull())
+                {
+                    lo = 0xcbf29ce484222325ULL;
+                    hi = 0x84222325cbf29ce4ULL;
+                }
+                for (size_t i = 0; i < size; i++)
+                {
+                    lo = (lo ^ bytes[i]) * prime;
+                    hi = (hi ^ bytes[i] ^ (lo >> 32)) * prime;
+                }
+            }
+
+            //! \brief Mix a value into the hash
+            template <typename T>
+            void Add(const T &value) { Add(&value, sizeof(T)); }
+        };
+
+        /*! \brief Compute a content hash of a mesh.
+
+        Hashes the vertices, faces (including smoothing groups and material ID:s), all supported map
+        channels, and the velocity map channel index. Objects that can produce a hash from their own
+        state more cheaply, without building the mesh, should do so instead, but this is a convenient
+        way to implement RenderInstanceSource::GetContentHash() for objects that already hold a mesh.
+        */
+        inline ContentHash ComputeMeshHash(Mesh &mesh, int velocityMapChannel = -1)
+        {
+            ContentHash hash;
+            hash.Add(mesh.numVerts);
+            hash.Add(mesh.numFaces);
+            hash.Add(velocityMapChannel);
+            hash.Add(mesh.verts, sizeof(Point3) * mesh.numVerts);
+            for (int f = 0; f < mesh.numFaces; f++)
+            {
+                const Face &face = mesh.faces[f];
+                hash.Add(face.v, sizeof(face.v));
+                hash.Add(face.smGroup);
+                hash.Add(face.getMatID());
+            }
+            for (int mp = 0; mp < mesh.getNumMaps(); mp++)
+            {
+                if (!mesh.mapSupport(mp))
+                    continue;
+                const MeshMap &map = mesh.maps[mp];
+                hash.Add(mp);
+                hash.Add(map.vnum);
+                hash.Add(map.fnum);
+                hash.Add(map.tv, sizeof(UVVert) * map.vnum);
+                hash.Add(map.tf, sizeof(TVFace) * map.fnum);
+            }
+            return hash;
+        }
+
+        /*! \brief A unique combination of per-instance overrides, see RenderInstanceSource::GetOverrideSets() */
+        struct OverrideSet {
+            Mtl                              *mtl;    //!< \brief As returned by RenderInstanceTarget::GetMtl()
+            MaxSDK::Array<InstanceMatIDInfo>  matIDs; //!< \brief As returned by RenderInstanceTarget::GetMatIDs()
+            MaxSDK::Array<InstanceUVWInfo>    uvws;   //!< \brief As returned by RenderInstanceTarget::GetUVWsVec()
+
+            OverrideSet() : mtl(nullptr) {}
+
+            //! \brief Returns true if this set holds exactly the given overrides
+            bool Matches(Mtl *m, ArrayView<InstanceMatIDInfo> ids, ArrayView<InstanceUVWInfo> uv) const
+            {
+                return mtl == m && matIDs.length() == ids.count && uvws.length() == uv.count
+                    && (ids.empty() || memcmp(matIDs.asArrayPtr(), ids.data, ids.count * sizeof(InstanceMatIDInfo)) == 0)
+                    && (uv.empty()  || memcmp(uvws.asArrayPtr(),   uv.data,  uv.count  * sizeof(InstanceUVWInfo))   == 0);
+            }
+        };
+
+        /*! \brief Cheap information about the data of a RenderInstanceSource, retrieved without materializing it.
+        \see RenderInstanceSource::GetMetadata() */
+        struct SourceMetadata {
+            Box3   bounds;      //!< \brief Bounding box of the data in its local space. Empty if unknown.
+            int    numVerts;    //!< \brief Number of vertices in the mesh, or -1 if unknown
+            int    numFaces;    //!< \brief Number of faces in the mesh, or -1 if unknown
+            size_t memoryBytes; //!< \brief Approximate memory GetData() will allocate, or 0 if unknown
+
+            SourceMetadata() : numVerts(-1), numFaces(-1), memoryBytes(0) { bounds.Init(); }
+        };
+
+        /*! \brief A transform as a 3x4 row-major float matrix (UpdateInfo::tmf_float3x4).
+
+        This is the column-vector convention used by most ray tracing APIs: a point <em>p</em> is
+        transformed as m * (p, 1), giving the same result as p * tm for the Matrix3 <em>tm</em>. */
+        struct TMFloat3x4 {
+            float m[3][4];
+        };
+
+        /*! \brief A transform as a translation, rotation and scale (UpdateInfo::tmf_trs).
+
+        The transform is scale, then rotation, then translation. The rotation is a unit quaternion (x, y, z, w)
+        in the same column-vector convention as TMFloat3x4. Mirroring is stored as a negative <em>s[0]</em>.
+        Shear can not be represented and is lost. */
+        struct TMTRS {
+            float t[3]; //!< \brief Translation
+            float q[4]; //!< \brief Rotation quaternion (x, y, z, w)
+            float s[3]; //!< \brief Scale along each local axis
+        };
+
+        /*! \brief A quantized transform (UpdateInfo::tmf_quantized).
+
+        The translation is quantized to 16 bits per axis relative to a range box passed to
+        RenderInstanceSource::GetTMsCompact(), typically the bounds of all target positions.
+        The rotation is a TMTRS quaternion quantized to 16-bit signed normalized values, and
+        the scale is reduced to a single uniform scale (the average of TMTRS::s). */
+        struct TMQuantized {
+            unsigned short t[3]; //!< \brief Translation, 0 is range min and 65535 is range max
+            short          q[4]; //!< \brief Rotation quaternion (x, y, z, w), scaled by 32767
+            unsigned short pad;  //!< \brief Unused, zero
+            float          s;    //!< \brief Uniform scale
+        };
+
+        //! \brief Get the size in bytes of one transform of the given format
+        inline size_t GetTMFormatSize(UpdateInfo::TMFormat format)
+        {
+            switch (format)
+            {
+                case UpdateInfo::tmf_float3x4:  return sizeof(TMFloat3x4);
+                case UpdateInfo::tmf_trs:       return sizeof(TMTRS);
+                case UpdateInfo::tmf_quantized: return sizeof(TMQuantized);
+                default:                            return sizeof(Matrix3);
+            }
+        }
+
+        /*! \brief Convert a Matrix3 to a compact transform format.
+
+        @param tm The transform to convert
+        @param format The format to write
+        @param out Receives one transform of GetTMFormatSize(format) bytes
+        @param range For UpdateInfo::tmf_quantized only - the box translations are quantized relative to.
+        */
+        inline void ConvertTM(const Matrix3 &tm, UpdateInfo::TMFormat format, void *out, const Box3 *range = nullptr)
+        {
+            if (format == UpdateInfo::tmf_matrix3)
+            {
+                *(Matrix3*)out = tm;
+                return;
+            }
+            if (format == UpdateInfo::tmf_float3x4)
+            {
+                TMFloat3x4 &m = *(TMFloat3x4*)out;
+                for (int r = 0; r < 3; r++)
+                    for (int c = 0; c < 4; c++)
+                        m.m[r][c] = tm.GetRow(c)[r];
+                return;
+            }
+
+            // Split into scale and rotation
+            TMTRS  trs;
+            Point3 row[3] = { tm.GetRow(0), tm.GetRow(1), tm.GetRow(2) };
+            for (int i = 0; i < 3; i++)
+            {
+                trs.s[i] = row[i].Length();
+                if (trs.s[i] > 0.0f)
+                    row[i] = row[i] * (1.0f / trs.s[i]);
+            }
+            if (DotProd(CrossProd(row[0], row[1]), row[2]) < 0.0f)
+            {
+                trs.s[0] = -trs.s[0];
+                row[0]   = row[0] * -1.0f;
+            }
+
+            // Rotation matrix to quaternion, with a[i][j] = row[j][i] in column-vector convention
+            float a00 = row[0].x, a01 = row[1].x, a02 = row[2].x;
+            float a10 = row[0].y, a11 = row[1].y, a12 = row[2].y;
+            float a20 = row[0].z, a21 = row[1].z, a22 = row[2].z;
+            float trace = a00 + a11 + a22;
+            float *q = trs.q;
+            if (trace > 0.0f)
+            {
+                float k = 0.5f / sqrtf(trace + 1.0f);
+                q[3] = 0.25f / k;
+                q[0] = (a21 - a12) * k;
+                q[1] = (a02 - a20) * k;
+                q[2] = (a10 - a01) * k;
+            }
+            else if (a00 > a11 && a00 > a22)
+            {
+                float k = 2.0f * sqrtf(1.0f + a00 - a11 - a22);
+                q[3] = (a21 - a12) / k;
+                q[0] = 0.25f * k;
+                q[1] = (a01 + a10) / k;
+                q[2] = (a02 + a20) / k;
+            }
+            else if (a11 > a22)
+            {
+                float k = 2.0f * sqrtf(1.0f + a11 - a00 - a22);
+                q[3] = (a02 - a20) / k;
+                q[0] = (a01 + a10) / k;
+                q[1] = 0.25f * k;
+                q[2] = (a12 + a21) / k;
+            }
+            else
+            {
+                float k = 2.0f * sqrtf(1.0f + a22 - a00 - a11);
+                q[3] = (a10 - a01) / k;
+                q[0] = (a02 + a20) / k;
+                q[1] = (a12 + a21) / k;
+                q[2] = 0.25f * k;
+            }
+            Point3 trans = tm.GetRow(3);
+            for (int i = 0; i < 3; i++)
+                trs.t[i] = trans[i];
+
+            if (format == UpdateInfo::tmf_trs)
+            {
+                *(TMTRS*)out = trs;
+                return;
+            }
+
+            TMQuantized &quant = *(TMQuantized*)out;
+            for (int i = 0; i < 3; i++)
+            {
+                float lo    = range ? range->pmin[i] : 0.0f;
+                float width = range ? range->pmax[i] - lo : 0.0f;
+                float f     = (width > 0.0f) ? (trs.t[i] - lo) / width : 0.0f;
+                f = (f < 0.0f) ? 0.0f : (f > 1.0f ? 1.0f : f);
+                quant.t[i] = (unsigned short)(f * 65535.0f + 0.5f);
+            }
+            for (int i = 0; i < 4; i++)
+                quant.q[i] = (short)floorf(q[i] * 32767.0f + 0.5f);
+            quant.pad = 0;
+            quant.s   = (fabsf(trs.s[0]) + trs.s[1] + trs.s[2]) / 3.0f;
+        }
+
         /*! \brief Information about a given instance of a RenderInstanceSource */
         class RenderInstanceTarget
         {
@@ -396,6 +1321,10 @@ namespace MaxSDK
               the interval, etc. 
 
             A vector with more than two elements allows a renderer to compute more accurate multi-sample motion blur.
+
+            If the object honored a sample count requested in UpdateInfo::numSamples, a moving instance
+            returns exactly that many transforms. A static instance should always return a single transform,
+            see IsStatic().
             */
             virtual MaxSDK::Array<Matrix3> GetTMs() = 0;
 
@@ -420,14 +1349,154 @@ namespace MaxSDK
             Returns the spin is the per-frame instance spin of the instance, as an AngAxis in units per tick.
             */
             virtual AngAxis GetSpin() = 0;
-            ///@}
-        };
 
-        /*! \brief Information about a given source, to be instanced multiple times */
-        class RenderInstanceSource
-        {
-        public:
-            /*! \brief Get the flags that define the type of data stored.
+            /*! \brief Returns true if the instance is not moving during the motion blur interval.
+
+            A renderer can then store a single transform for the instance, regardless of how many
+            motion samples it uses for moving instances. The default implementation returns true
+            if GetTMs() returns a single transform.
+            */
+            virtual bool IsStatic() { return GetTMs().length() <= 1; }
+            ///@}
+
+            /*! \name Overrides without allocation */
+            ///@{
+            /*! \brief Get material ID overrides without allocating.
+
+            Same as GetMatIDs(), but returns a view of the overrides instead of a copy. The view
+            is valid until the next call on this target (or on any target retrieved by the same
+            thread), and is empty if the instance has no overrides.
+
+            The default implementation copies GetMatIDs() into per-thread storage. Objects should
+            override it to return a view of their own data.
+            */
+            virtual ArrayView<InstanceMatIDInfo> GetMatIDsView()
+            {
+                static thread_local MaxSDK::Array<InstanceMatIDInfo> matIDs;
+                matIDs = GetMatIDs();
+                return ArrayView<InstanceMatIDInfo>(matIDs.asArrayPtr(), matIDs.length());
+            }
+
+            /*! \brief Get per-instance UVW channel overrides without allocating.
+
+            Same as GetUVWsVec(), but returns a view of the overrides instead of a copy, with the
+            same lifetime rules as GetMatIDsView().
+            */
+            virtual ArrayView<InstanceUVWInfo> GetUVWsView()
+            {
+                static thread_local MaxSDK::Array<InstanceUVWInfo> uvws;
+                uvws = GetUVWsVec();
+                return ArrayView<InstanceUVWInfo>(uvws.asArrayPtr(), uvws.length());
+            }
+            ///@}
+
+            /*! \brief Get the views the instance is visible in.
+
+            With UpdateInfo::uf_multiView, bit <em>i</em> is set if the instance is visible in UpdateInfo::views[i],
+            so each view can skip the instances not meant for it. The default implementation returns all ones.
+            */
+            virtual unsigned __int64 GetVisibilityMask() { return ~0ULL; }
+        };
+
+        /*! \brief Structure-of-arrays transform buffers, filled in by RenderInstanceSource::GetTMsBatchSoA()
+
+        Each pointer is a caller-owned array, or nullptr if that part of the transform is not wanted.
+        Rows are as returned by Matrix3::GetRow(). */
+        struct TMArrays {
+            Point3 *row0;   //!< \brief First row of the rotation/scale part (X axis)
+            Point3 *row1;   //!< \brief Second row of the rotation/scale part (Y axis)
+            Point3 *row2;   //!< \brief Third row of the rotation/scale part (Z axis)
+            Point3 *trans;  //!< \brief The translation row
+        };
+
+        /*! \brief A strided, read-only view of one custom data channel over all targets of a source.
+
+        Value <em>i</em> (for target <em>i</em>) is found at <em>data + i * stride</em>.
+        Returned by RenderInstanceSource::GetChannelView(). */
+        struct ChannelView {
+            const void *data;   //!< \brief Pointer to the value of the first target
+            size_t      stride; //!< \brief Distance in bytes between the values of consecutive targets
+            size_t      count;  //!< \brief Number of values in the view
+        };
+
+        /*! \brief Get the size in bytes of one value of a channel of the given type.
+            Returns 0 for ChannelInfo::typeCustom, whose size is given by ChannelInfo::size. */
+        inline size_t GetChannelTypeSize(ChannelInfo::TypeID type)
+        {
+            switch (type)
+            {
+                case ChannelInfo::typeInt:    return sizeof(int);
+                case ChannelInfo::typeFloat:  return sizeof(float);
+                case ChannelInfo::typeVector: return sizeof(Point3);
+                case ChannelInfo::typeColor:  return sizeof(Color);
+                case ChannelInfo::typeTM:     return sizeof(Matrix3);
+                default:                      return 0;
+            }
+        }
+
+        /*! \brief Transform and motion of a target, filled in by RenderInstanceSource::GetMotionBatch() */
+        struct TargetMotion {
+            Matrix3 tm;       //!< \brief The transform at shutter open, as RenderInstanceTarget::GetTM()
+            Point3  velocity; //!< \brief As RenderInstanceTarget::GetVelocity()
+            AngAxis spin;     //!< \brief As RenderInstanceTarget::GetSpin()
+        };
+
+        /*! \brief A cursor over chunks of targets, for streaming.
+        \see RenderInstanceSource::AcquireTargetChunk() */
+        struct TargetChunk {
+            size_t first;    //!< \brief Index of the first target of the chunk
+            size_t count;    //!< \brief Number of targets in the chunk
+            size_t maxCount; //!< \brief The maximum number of targets the renderer wants per chunk
+            void  *handle;   //!< \brief Owned by the object, for example to identify the memory block of the chunk
+
+            TargetChunk(size_t maxTargets = 65536) : first(0), count(0), maxCount(maxTargets), handle(nullptr) {}
+        };
+
+        /*! \brief Caller-owned storage for targets retrieved with RenderInstanceSource::GetRenderInstanceTargetInContext().
+
+        A renderer creates one context per worker thread (or per target it wants to hold at the same time),
+        for a given source. The object builds targets inside the context storage, so the hot path needs
+        neither allocations nor thread local storage lookups. A context must be destroyed before
+        RenderTimeInstancing::ReleaseInstanceData() is called. Contexts may only be created for sources of an
+        instancer obtained with GetExtendedRenderTimeInstancing().
+        \code
+        TargetContext context(source);
+        for (size_t i = first; i < last; i++)
+        {
+            RenderInstanceTarget *target = source->GetRenderInstanceTargetInContext(i, context);
+            ...
+        }
+        \endcode
+        */
+        class TargetContext {
+        public:
+            //! \brief Allocate a context for <em>source</em>, of RenderInstanceSource::GetTargetContextSize() bytes
+            explicit TargetContext(RenderInstanceSource *source);
+            //! \brief Calls RenderInstanceSource::ReleaseTargetContext() and frees the storage
+            ~TargetContext();
+
+            TargetContext(const TargetContext&)            = delete;
+            TargetContext &operator=(const TargetContext&) = delete;
+
+            RenderInstanceSource *Source()  const { return m_source; }
+            //! \brief The storage, aligned for any fundamental type. nullptr if Size() is 0.
+            void                 *Storage() const { return m_storage; }
+            size_t                Size()    const { return m_size; }
+
+            //! \brief Free for use by the object, for example to remember what it has built in the storage. Initially nullptr.
+            void *pluginData;
+
+        private:
+            RenderInstanceSource *m_source;
+            void                 *m_storage;
+            size_t                m_size;
+        };
+
+        /*! \brief Information about a given source, to be instanced multiple times */
+        class RenderInstanceSource
+        {
+        public:
+            /*! \brief Get the flags that define the type of data stored.
 
             Defines the type returned in the GetData() pointer, and any other relevant information,
             like whether the plugin must delete the pointer once it's finished using it.
@@ -436,9 +1505,21 @@ namespace MaxSDK
 
             /*! \brief Get the data pointer for that item that that should be instanced. 
             
-            Currently, it is either a Mesh* or an INode*, and
+            Currently, it is either a Mesh*, an INode* or a RenderTimeInstancing*, and
             the flags returned by GetFlags() can be queried to find out which class type it is.
 
+            A RenderTimeInstancing* (df_instancer) is a nested instancer, for example one clump of grass
+            that is itself instanced across a field. This allows a renderer to build a two-level instance
+            hierarchy instead of a flattened list of targets. For a nested instancer:
+            - The owning object has already updated it, with the same MotionBlurInfo, as part of its own
+              RenderTimeInstancing::UpdateInstanceData(), and releases it in its own ReleaseInstanceData().
+              The renderer must never call UpdateInstanceData() or ReleaseInstanceData() on it, nor delete it.
+            - The transforms of its targets are relative to the targets of this source, i.e. the world
+              transform of a nested target is nestedTM * targetTM.
+            - The same nested instancer may be returned by several sources, or several different objects, so
+              a renderer should translate it once, keyed on the pointer, and instance the result.
+            Use GetTotalInstanceCount() to find the number of leaf instances a hierarchy expands to.
+
             The variable should only have one class type flag set, but may
             have other relevant information flagged as well, so one should not
             test for the class type with the equality ('==') operator, but instead
@@ -453,6 +1534,19 @@ namespace MaxSDK
             If the "pluginMustDelete" flag is set, the pointer should be deleted 
             after use. Be sure to cast to relevant class before deletion
             so the proper destructor is called.
+
+            If the "borrowed" flag is set, the pointer refers to data owned by the object, typically a
+            shared, unchanged mesh, handed out without making a copy. Each call to GetData() then adds a
+            reference, which the renderer must give back with ReleaseData() once it no longer uses the data,
+            and at the latest before RenderTimeInstancing::ReleaseInstanceData(). The object may free the data
+            as soon as all references are released. The two flags are never set at the same time.
+            ScopedSourceData handles both cases.
+
+            \note GetData() is the point where the data is <em>materialized</em>. Objects should not
+            build meshes for their sources up front in RenderTimeInstancing::UpdateInstanceData(), but
+            defer it until GetData() is called, since a renderer may cull all targets of a source or
+            already have its geometry cached (see GetContentHash()). Cheap information about the
+            source can be provided without materializing it through GetMetadata().
             */
             virtual void *GetData() = 0;
 
@@ -475,14 +1569,15 @@ namespace MaxSDK
             vertex count is identical to the mesh vertex count, the map/mesh
             vertex indices may not correspond to each other.
 
-            Here is an example of how vertex velocities could be retrieved from
-            the velocity map channel, through a RenderInstanceSource:
+            ExtractVertexVelocities() implements this, and GetSourceVertexVelocities() additionally
+            uses the velocities cached by extended objects, see GetVertexVelocities(). For reference, this
+            is how vertex velocities are retrieved from the velocity map channel of a RenderInstanceSource:
             \code
             ////
 
             std::vector<Point3> vertexVelocities(mesh.numVerts, Point3(0,0,0));
 
-            int velMapChan = renderInstanceSource->GetMeshVelocityMapChannel();
+            int velMapChan = renderInstanceSource->GetVelocityMapChannel();
             if (velMapChan >= 0 && mesh.mapSupport(velMapChan))
             {
                 MeshMap &map = mesh.maps[velMapChan];
@@ -514,6 +1609,28 @@ namespace MaxSDK
             virtual size_t                GetNumInstanceTargets() = 0;
             /*! \brief Get the n:th instances of this source. */
             virtual RenderInstanceTarget *GetRenderInstanceTarget(size_t index) = 0;
+            /*! \brief Get the n:th instances of this source, using caller-owned storage.
+
+            Instead of reusing hidden per-thread memory, the object builds the target inside the
+            <em>context</em>, which the renderer allocated (typically one per worker thread) and passes
+            explicitly. The returned target is valid until the next call with the same context, or until
+            the context is destroyed. Targets retrieved through <em>different</em> contexts are independent,
+            so a renderer may hold several at the same time, for example to compare adjacent targets.
+
+            A context may only be used by one thread at a time. The default implementation ignores the
+            context and calls the function above, in which case the usual per-thread rules apply.
+
+            \see Class TargetContext
+            */
+            virtual RenderInstanceTarget *GetRenderInstanceTargetInContext(size_t index, TargetContext &context) { return GetRenderInstanceTarget(index); }
+
+            /*! \brief Get the number of bytes of storage a TargetContext for this source needs.
+            Returns 0 if the object does not use context storage, which is the default. */
+            virtual size_t GetTargetContextSize() { return 0; }
+
+            /*! \brief Called when a TargetContext of this source is destroyed, so the object can destroy
+            anything it built in the context storage. The default implementation does nothing. */
+            virtual void ReleaseTargetContext(TargetContext &context) {}
 
             //! \brief For convenicence - iterator
             class Iterator;
@@ -533,11 +1650,972 @@ namespace MaxSDK
                 size_t                 m_i;
                 RenderInstanceSource  *m_item;
             };
+
+            /*! \brief Hint that the calling thread is about to iterate targets [first, first + count).
+
+            This is called by TargetRange and ForEachTargetRange() from the worker thread that will access
+            the range, before any of its targets are retrieved. An object may use it to prefetch or
+            decompress the range into the per-thread memory used by GetRenderInstanceTarget().
+            The default implementation does nothing.
+            */
+            virtual void PrefetchTargets(size_t first, size_t count) {}
+
+            /*! \brief Acquire the next chunk of targets, for streaming.
+
+            When the object honored UpdateInfo::uf_streaming, it does not materialize all its targets in
+            RenderTimeInstancing::UpdateInstanceData(). Instead the renderer pulls them in chunks, and only
+            targets inside an acquired chunk may be accessed, through GetRenderInstanceTarget() or any of the
+            batch functions. GetNumInstanceTargets() still returns the total number of targets, and target
+            indices are the same as they would be without streaming. This bounds the memory used on both
+            sides to the chunks held at the same time, regardless of the total number of targets.
+
+            The chunk acts as the cursor: initialize it with TargetChunk(maxCount) and call this repeatedly.
+            Each call continues after the previous chunk. Each acquired chunk must be released with
+            ReleaseTargetChunk() as soon as the renderer has consumed it.
+            \code
+            TargetChunk chunk(updinfo.streamChunkSize);
+            while (source->AcquireTargetChunk(chunk))
+            {
+                source->GetTMsBatch(chunk.first, chunk.count, numSamples, tms);
+                ... consume targets [chunk.first, chunk.first + chunk.count) ...
+                source->ReleaseTargetChunk(chunk);
+            }
+            \endcode
+
+            The default implementation, for objects that do not stream, just advances the range over
+            the already materialized targets.
+
+            @param chunk The cursor. Upon return it holds the newly acquired range.
+            @return false if there are no more targets, in which case no chunk was acquired.
+
+            \see Struct TargetChunk
+            */
+            virtual bool AcquireTargetChunk(TargetChunk &chunk)
+            {
+                chunk.first += chunk.count;
+                chunk.count  = ClampTargetRange(chunk.first, chunk.maxCount);
+                return chunk.count > 0;
+            }
+
+            /*! \brief Release a chunk acquired with AcquireTargetChunk().
+
+            After this no targets of the chunk may be accessed, and the object may free their memory. The
+            cursor itself remains valid for acquiring the next chunk. The default implementation does nothing.
+            */
+            virtual void ReleaseTargetChunk(TargetChunk &chunk) {}
+            ///@}
+
+            /*! \name Information about the source */
+            ///@{
+            /*! \brief Get cheap information about the data of this source, without materializing it.
+
+            This allows a renderer to decide whether it needs to call GetData() at all, for example
+            after culling all targets against GetMetadata() bounds, or after finding the
+            GetContentHash() in its geometry cache. It should not build the mesh.
+
+            @param metadata Receives the metadata. Fields the object does not know are left at their defaults.
+            @return true if any metadata was filled in. The default implementation returns false.
+
+            \see Struct SourceMetadata
+            */
+            virtual bool GetMetadata(SourceMetadata &metadata) { return false; }
+
+            /*! \brief Release a reference to data returned by GetData() with the df_borrowed flag.
+
+            Must be called exactly once for each call to GetData() that returned df_borrowed data, with the
+            returned pointer. The data may not be used afterwards. The default implementation does nothing.
+            */
+            virtual void ReleaseData(void *data) {}
+
+            /*! \brief Get the bounding box of the data of this source, in its local space.
+
+            The box is what the targets' transforms are applied to. It should be cheap to compute
+            and not require materializing the data. The default implementation returns the
+            bounds from GetMetadata(), which is an empty box if they are unknown.
+            */
+            virtual Box3 GetLocalBounds()
+            {
+                SourceMetadata metadata;
+                GetMetadata(metadata);
+                return metadata.bounds;
+            }
+
+            /*! \brief Get the per-vertex velocities of the mesh returned by GetData().
+
+            Objects that generate velocities, or that have already extracted them from the velocity map
+            channel, can return them here so renderers do not scatter the map channel themselves every
+            frame. The velocities are in mesh vertex order, in the same units as the velocity map channel,
+            and stay valid until RenderTimeInstancing::ReleaseInstanceData() is called.
+
+            @param velocities Receives a view of one velocity per mesh vertex.
+            @return true if the velocities are available. The default implementation returns false.
+            \see GetSourceVertexVelocities()
+            */
+            virtual bool GetVertexVelocities(ArrayView<Point3> &velocities) { return false; }
+
+            /*! \brief Get which kinds of overrides the targets of this source may have.
+
+            Allows a renderer to skip calling RenderInstanceTarget::GetMtl(), GetMatIDs() and
+            GetUVWsVec() (or their view variants) entirely when a source has no overrides of that kind.
+            A set flag only means targets <em>may</em> have that override, a cleared flag means that
+            <em>no</em> target has it.
+
+            The default implementation returns of_all, i.e. every target must be checked.
+            */
+            virtual OverrideFlags GetOverrideFlags() { return of_all; }
+
+            /*! \brief Get the distinct combinations of overrides used by the targets of this source.
+
+            Most instances usually share a few combinations of material, material ID and UVW overrides.
+            This returns each combination once, and for each target the index of its combination, so a
+            renderer can bucket the targets by shading state in a single pass. Overrides of kinds that
+            GetOverrideFlags() reports as absent are left empty.
+
+            Objects that already store their overrides as a table should return it directly. The default
+            implementation queries every target and removes duplicates.
+
+            @param sets Receives the distinct override sets.
+            @param indices Caller-owned buffer of GetNumInstanceTargets() values. Receives the index into
+                   <em>sets</em> of the overrides of each target.
+            @return The number of sets.
+            */
+            virtual size_t GetOverrideSets(MaxSDK::Array<OverrideSet> &sets, unsigned int *indices)
+            {
+                sets.removeAll();
+                OverrideFlags flags = GetOverrideFlags();
+                size_t        num   = GetNumInstanceTargets();
+                if (flags == of_none)
+                {
+                    sets.append(OverrideSet());
+                    for (size_t i = 0; i < num; i++)
+                        indices[i] = 0;
+                    return sets.length();
+                }
+
+                std::map<ContentHash, unsigned int> lookup;
+                std::vector<InstanceMatIDInfo>      matIDStorage;
+                for (size_t i = 0; i < num; i++)
+                {
+                    RenderInstanceTarget            *target = GetRenderInstanceTarget(i);
+                    Mtl                             *mtl    = (flags & of_mtl) ? target->GetMtl() : nullptr;
+                    ArrayView<InstanceMatIDInfo>     matIDs;
+                    if (flags & of_matIDs)
+                    {
+                        // Copied, since the view is only valid until GetUVWsView() is called
+                        ArrayView<InstanceMatIDInfo> view = target->GetMatIDsView();
+                        matIDStorage.assign(view.begin(), view.end());
+                        matIDs = ArrayView<InstanceMatIDInfo>(matIDStorage.data(), matIDStorage.size());
+                    }
+                    ArrayView<InstanceUVWInfo>       uvws   = (flags & of_uvws) ? target->GetUVWsView() : ArrayView<InstanceUVWInfo>();
+
+                    ContentHash hash;
+                    hash.Add(mtl);
+                    hash.Add(matIDs.count);
+                    hash.Add(matIDs.data, matIDs.count * sizeof(InstanceMatIDInfo));
+                    hash.Add(uvws.count);
+                    hash.Add(uvws.data, uvws.count * sizeof(InstanceUVWInfo));
+
+                    auto found = lookup.find(hash);
+                    if (found != lookup.end() && sets[found->second].Matches(mtl, matIDs, uvws))
+                    {
+                        indices[i] = found->second;
+                        continue;
+                    }
+
+                    OverrideSet set;
+                    set.mtl = mtl;
+                    set.matIDs.setLengthUsed(matIDs.count);
+                    set.uvws.setLengthUsed(uvws.count);
+                    if (!matIDs.empty()) memcpy(set.matIDs.asArrayPtr(), matIDs.data, matIDs.count * sizeof(InstanceMatIDInfo));
+                    if (!uvws.empty())   memcpy(set.uvws.asArrayPtr(),   uvws.data,   uvws.count   * sizeof(InstanceUVWInfo));
+
+                    indices[i] = (unsigned int)sets.length();
+                    if (found == lookup.end())
+                        lookup[hash] = indices[i];
+                    sets.append(set);
+                }
+                return sets.length();
+            }
+
+            /*! \brief Get the generation counter of this source.
+
+            The generation is a monotonically increasing number that the object increments every
+            time anything about this source changes in RenderTimeInstancing::UpdateInstanceData().
+            A renderer can store it with its translated data and compare it after the next update
+            to know whether the source needs to be translated again.
+
+            A value of 0 means the object does not track generations, and the source should always
+            be treated as changed. The default implementation returns 0.
+            */
+            virtual unsigned __int64 GetGeneration() { return 0; }
+
+            /*! \brief Get which targets of this source changed in the last RenderTimeInstancing::UpdateInstanceData().
+
+            This allows a renderer to upload only the changed transforms and refit its acceleration structures,
+            instead of fetching all of them again, when only some of the instances move between frames.
+            Only meaningful for a source that was modified with ChangeSet::ch_transforms or ChangeSet::ch_targets;
+            the targets of an unmodified source are all unchanged.
+
+            @param changes Receives the changes, relative to the previous update.
+            @return true if the changes are known. If false, which is the default, all targets should be treated as changed.
+            \see Struct TargetChanges
+            */
+            virtual bool GetTargetChanges(TargetChanges &changes) { return false; }
+
+            /*! \brief Get a content hash of the data of this source.
+
+            The hash covers everything that affects the translated geometry: the mesh (or node)
+            geometry, all map channels, and the velocity map channel. It must be stable across
+            frames, sessions and render nodes, so that a renderer can use it to key a persistent
+            geometry cache and skip both calling GetData() and rebuilding its own acceleration
+            structures when the hash is already known.
+
+            This should be cheap to call, and should not require building the mesh. ComputeMeshHash()
+            can be used by objects that already have the mesh available.
+
+            @param hash Receives the hash.
+            @return true if a hash is available. The default implementation returns false.
+            */
+            virtual bool GetContentHash(ContentHash &hash) { return false; }
+
+            /*! \brief Returns true if no target of this source is moving during the motion blur interval.
+
+            This allows a renderer to store a single transform per target for the whole source, and fetch
+            them with GetTMsBatch() using a single sample, without checking RenderInstanceTarget::IsStatic()
+            on each target. The default implementation returns false.
+            */
+            virtual bool IsAllStatic() { return false; }
+            ///@}
+
+            /*! \name Batch access to the instance targets
+
+            These functions copy data for a contiguous range of targets into caller-owned
+            buffers, avoiding the per-instance virtual calls and array allocations of
+            GetRenderInstanceTarget() and RenderInstanceTarget::GetTMs().
+
+            The default implementations simply loop over GetRenderInstanceTarget(), so they
+            are always safe to call. An object that stores its instances contiguously should
+            override them with a direct copy.
+            */
+            ///@{
+            /*! \brief Copy the transforms of a range of targets into a contiguous buffer.
+
+            Writes <em>numSamples</em> transforms for each target in [first, first + count),
+            spread evenly over the motion blur interval in the same way as RenderInstanceTarget::GetTMs().
+            The transforms of target <em>first + i</em> are stored at out[i * numSamples] through
+            out[i * numSamples + numSamples - 1].
+
+            If a target internally has a different number of samples than requested, the
+            nearest sample in time is used for each slot, so a static target simply gets
+            its single transform repeated.
+
+            @param first The index of the first target to copy.
+            @param count The number of targets to copy. Clamped to GetNumInstanceTargets().
+            @param numSamples The number of motion samples to write per target. Must be at least 1.
+            @param out Caller-owned buffer of at least count * numSamples elements.
+            @return The number of targets actually written.
+            */
+            virtual size_t GetTMsBatch(size_t first, size_t count, int numSamples, Matrix3 *out)
+            {
+                count = ClampTargetRange(first, count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    auto tms = GetRenderInstanceTarget(first + i)->GetTMs();
+                    for (int s = 0; s < numSamples; s++)
+                        out[i * numSamples + s] = tms[NearestSample(s, numSamples, tms.length())];
+                }
+                return count;
+            }
+
+            /*! \brief Copy the transforms of a range of targets into structure-of-arrays buffers.
+
+            Same as GetTMsBatch(), but splits each transform into its three rotation/scale rows and its
+            translation row, each stored in a separate array using the same indexing. Any of the
+            pointers in <em>out</em> may be nullptr, in which case that part is skipped. This allows, for
+            example, fetching only translations for a point-based preview.
+
+            \see Struct TMArrays
+            */
+            virtual size_t GetTMsBatchSoA(size_t first, size_t count, int numSamples, TMArrays &out)
+            {
+                count = ClampTargetRange(first, count);
+                for (size_t i = 0; i < count; i++)
+                {
+                    auto tms = GetRenderInstanceTarget(first + i)->GetTMs();
+                    for (int s = 0; s < numSamples; s++)
+                    {
+                        const Matrix3 &tm = tms[NearestSample(s, numSamples, tms.length())];
+                        size_t         o  = i * numSamples + s;
+                        if (out.row0)  out.row0[o]  = tm.GetRow(0);
+                        if (out.row1)  out.row1[o]  = tm.GetRow(1);
+                        if (out.row2)  out.row2[o]  = tm.GetRow(2);
+                        if (out.trans) out.trans[o] = tm.GetRow(3);
+                    }
+                }
+                return count;
+            }
+
+            /*! \brief Copy the shutter open transform, velocity and spin of a range of targets as packed records.
+
+            Equivalent to calling RenderInstanceTarget::GetTM(), GetVelocity() and GetSpin() for each target
+            in [first, first + count), for renderers that use velocity and spin for motion blur
+            (MotionBlurInfo::mb_velocityspin). The default implementation calls GetMotionBatchSoA().
+
+            @param first The index of the first target to copy.
+            @param count The number of targets to copy. Clamped to GetNumInstanceTargets().
+            @param out Caller-owned buffer of at least count records.
+            @return The number of targets actually written.
+
+            \see Struct TargetMotion
+            */
+            virtual size_t GetMotionBatch(size_t first, size_t count, TargetMotion *out)
+            {
+                count = ClampTargetRange(first, count);
+                const size_t chunkSize = 256;
+                Matrix3      tms[chunkSize];
+                Point3       velocities[chunkSize];
+                AngAxis      spins[chunkSize];
+                for (size_t done = 0; done < count; done += chunkSize)
+                {
+                    size_t n = GetMotionBatchSoA(first + done, (count - done < chunkSize) ? count - done : chunkSize, tms, velocities, spins);
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        out[done + i].tm       = tms[i];
+                        out[done + i].velocity = velocities[i];
+                        out[done + i].spin     = spins[i];
+                    }
+                }
+                return count;
+            }
+
+            /*! \brief Copy the shutter open transform, velocity and spin of a range of targets into separate arrays.
+
+            Same as GetMotionBatch(), but as structure-of-arrays, which is better suited for SIMD processing.
+            Any of the pointers may be nullptr, in which case that part is skipped. The default implementation
+            uses GetTMsBatch() for the transforms, and loops over the targets for velocity and spin.
+            */
+            virtual size_t GetMotionBatchSoA(size_t first, size_t count, Matrix3 *tms, Point3 *velocities, AngAxis *spins)
+            {
+                count = ClampTargetRange(first, count);
+                if (tms)
+                    GetTMsBatch(first, count, 1, tms);
+                if (velocities || spins)
+                {
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        RenderInstanceTarget *target = GetRenderInstanceTarget(first + i);
+                        if (velocities) velocities[i] = target->GetVelocity();
+                        if (spins)      spins[i]      = target->GetSpin();
+                    }
+                }
+                return count;
+            }
+
+            /*! \brief Copy the transforms of a range of targets in a compact format.
+
+            Same as GetTMsBatch(), but writes each transform in the given format, at
+            GetTMFormatSize(format) bytes per transform. Objects that store transforms in the format
+            they returned in UpdateInfo::tmFormat should override this to write them with no
+            conversion. The default implementation converts the result of GetTMsBatch() using ConvertTM().
+
+            @param first The index of the first target to copy.
+            @param count The number of targets to copy. Clamped to GetNumInstanceTargets().
+            @param numSamples The number of motion samples to write per target. Must be at least 1.
+            @param format The format to write.
+            @param out Caller-owned buffer of at least count * numSamples * GetTMFormatSize(format) bytes.
+            @param range For UpdateInfo::tmf_quantized only - the box translations are quantized relative to.
+            @return The number of targets actually written.
+            */
+            virtual size_t GetTMsCompact(size_t first, size_t count, int numSamples, UpdateInfo::TMFormat format,
+                                         void *out, const Box3 *range = nullptr)
+            {
+                count = ClampTargetRange(first, count);
+                size_t               size = GetTMFormatSize(format);
+                char                *dst  = (char*)out;
+                std::vector<Matrix3> tms(numSamples);
+                for (size_t i = 0; i < count; i++)
+                {
+                    GetTMsBatch(first + i, 1, numSamples, tms.data());
+                    for (int s = 0; s < numSamples; s++, dst += size)
+                        ConvertTM(tms[s], format, dst, range);
+                }
+                return count;
+            }
+
+            /*! \brief Compute the world space bounding boxes of a range of targets.
+
+            Each box is GetLocalBounds() transformed by the target's transform. If <em>motionBlur</em>
+            is true, the box is the union over all transforms returned by RenderInstanceTarget::GetTMs(),
+            i.e. it is expanded to cover the motion over MotionBlurInfo::shutterInterval. Otherwise only
+            the shutter open transform is used.
+
+            This allows building a top-level acceleration structure directly from the interface, in a
+            single pass over the targets. If GetLocalBounds() is empty, all returned boxes are empty.
+
+            \note With only a few motion samples, a rotating instance may slightly exceed the union of
+            its sampled boxes between samples. Renderers that need conservative bounds should pad them.
+
+            @param first The index of the first target.
+            @param count The number of targets. Clamped to GetNumInstanceTargets().
+            @param out Caller-owned buffer of at least count boxes.
+            @param motionBlur Whether to expand the bounds over the motion blur interval.
+            @return The number of boxes actually written.
+            */
+            virtual size_t GetWorldBoundsBatch(size_t first, size_t count, Box3 *out, bool motionBlur = true)
+            {
+                count = ClampTargetRange(first, count);
+                Box3 local = GetLocalBounds();
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i].Init();
+                    if (local.IsEmpty())
+                        continue;
+                    RenderInstanceTarget *target = GetRenderInstanceTarget(first + i);
+                    if (motionBlur)
+                    {
+                        auto tms = target->GetTMs();
+                        for (size_t s = 0; s < tms.length(); s++)
+                            out[i] += local * tms[s];
+                    }
+                    else
+                        out[i] = local * target->GetTM();
+                }
+                return count;
+            }
+
+            /*! \brief Get the visibility masks of a range of targets.
+
+            @param first The index of the first target.
+            @param count The number of targets. Clamped to GetNumInstanceTargets().
+            @param out Caller-owned buffer of at least count masks.
+            @return The number of masks actually written.
+            \see RenderInstanceTarget::GetVisibilityMask()
+            */
+            virtual size_t GetVisibilityMaskBatch(size_t first, size_t count, unsigned __int64 *out)
+            {
+                count = ClampTargetRange(first, count);
+                for (size_t i = 0; i < count; i++)
+                    out[i] = GetRenderInstanceTarget(first + i)->GetVisibilityMask();
+                return count;
+            }
+
+            /*! \brief Get zero-copy access to a custom data channel for all targets.
+
+            If the object stores the values of the channel contiguously (or at a fixed stride) it can
+            return a view directly into its own memory, which stays valid until
+            RenderTimeInstancing::ReleaseInstanceData() is called. The view covers all
+            GetNumInstanceTargets() targets of this source.
+
+            @param channel The channel, as returned by RenderTimeInstancing::GetChannelID()
+            @param type The type of the channel. The values in the view are of this type.
+            @param view Receives the view on success.
+            @return true if a view was returned, false if the channel is not stored in a way
+                    that allows this, in which case GetChannelBatch() should be used instead.
+            */
+            virtual bool GetChannelView(ChannelID channel, ChannelInfo::TypeID type, ChannelView &view) { return false; }
+
+            /*! \brief Get direct access to the target records of this source.
+
+            An object that stores all per-target data of a source as an array of fixed-size records can return
+            it here. The value of a channel for target <em>i</em> is then found at
+            <em>records.data + i * records.stride + GetChannelOffset(channel)</em>, for every channel whose
+            GetChannelOffset() is not -1. This lets a renderer resolve the location of each channel once
+            per source, and read values with neither a virtual call nor a per-call lookup.
+            The records stay valid until RenderTimeInstancing::ReleaseInstanceData() is called.
+
+            @param records Receives a view of the records. Its <em>count</em> is GetNumInstanceTargets().
+            @return true if the records are available. The default implementation returns false.
+
+            \see ResolveChannelView()
+            */
+            virtual bool GetTargetRecords(ChannelView &records) { return false; }
+
+            /*! \brief Get the byte offset of a custom data channel inside each record returned by GetTargetRecords().
+            @param channel The channel, as returned by RenderTimeInstancing::GetChannelID()
+            @return The offset, or -1 if the channel is not stored in the records, which is the default. */
+            virtual int GetChannelOffset(ChannelID channel) { return -1; }
+
+            /*! \brief Copy the values of a custom data channel for a range of targets into a caller-owned buffer.
+
+            The value of target <em>first + i</em> is written to <em>(char*)out + i * stride</em>.
+            This is suitable for filling GPU user-data buffers directly.
+
+            @param channel The channel, as returned by RenderTimeInstancing::GetChannelID()
+            @param type The type of the channel. It is the responsibility of the caller to pass the correct type.
+            @param first The index of the first target to copy.
+            @param count The number of targets to copy. Clamped to GetNumInstanceTargets().
+            @param out Caller-owned buffer.
+            @param stride Distance in bytes between consecutive values in <em>out</em>. If 0, values are tightly packed.
+            @param customSize For ChannelInfo::typeCustom only - the size of each value (ChannelInfo::size).
+            @return The number of targets actually written.
+            */
+            virtual size_t GetChannelBatch(ChannelID channel, ChannelInfo::TypeID type, size_t first, size_t count,
+                                           void *out, size_t stride = 0, size_t customSize = 0)
+            {
+                size_t size = (type == ChannelInfo::typeCustom) ? customSize : GetChannelTypeSize(type);
+                if (stride == 0)
+                    stride = size;
+                count = ClampTargetRange(first, count);
+
+                char *dst = (char*)out;
+                ChannelView view;
+                if (GetChannelView(channel, type, view))
+                {
+                    const char *src = (const char*)view.data + first * view.stride;
+                    for (size_t i = 0; i < count; i++, src += view.stride, dst += stride)
+                        memcpy(dst, src, size);
+                    return count;
+                }
+
+                for (size_t i = 0; i < count; i++, dst += stride)
+                {
+                    RenderInstanceTarget *target = GetRenderInstanceTarget(first + i);
+                    switch (type)
+                    {
+                        case ChannelInfo::typeFloat:  *(float*)  dst = target->GetCustomFloat (channel); break;
+                        case ChannelInfo::typeVector: *(Point3*) dst = target->GetCustomVector(channel); break;
+                        case ChannelInfo::typeColor:  *(Color*)  dst = target->GetCustomColor (channel); break;
+                        case ChannelInfo::typeTM:     *(Matrix3*)dst = target->GetCustomTM    (channel); break;
+                        default:
+                        {
+                            void *data = target->GetCustomData(channel);
+                            if (data) memcpy(dst, data, size);
+                            else      memset(dst, 0, size);
+                        }
+                    }
+                }
+                return count;
+            }
+            ///@}
+
+        protected:
+            //! \brief Clamp a [first, first + count) range to the available targets, returning the new count
+            size_t ClampTargetRange(size_t first, size_t count)
+            {
+                size_t num = GetNumInstanceTargets();
+                if (first >= num)
+                    return 0;
+                return (count > num - first) ? num - first : count;
+            }
+
+            //! \brief Map sample slot <em>s</em> of <em>numSamples</em> to the nearest of <em>numAvailable</em> evenly spread samples
+            static size_t NearestSample(int s, int numSamples, size_t numAvailable)
+            {
+                if (numSamples <= 1 || numAvailable <= 1)
+                    return 0;
+                return (size_t)((double)s * (numAvailable - 1) / (numSamples - 1) + 0.5);
+            }
+        };
+
+        /*! \brief A contiguous range of targets of a source, for parallel traversal.
+
+        A TargetRange models the TBB splittable range concept (copy constructor, splitting constructor,
+        empty() and is_divisible()), so it can be passed directly to tbb::parallel_for. It can also be
+        iterated with a for (auto target : range) loop.
+
+        A range must be iterated by a <em>single thread</em>, one target at a time, which satisfies the
+        threading rules of RenderTimeInstancing. For sources of an instancer obtained with
+        GetExtendedRenderTimeInstancing(), call Prefetch() on the worker thread before iterating, and
+        optionally set a thread-owned TargetContext with SetContext() to retrieve targets through it. Without
+        either, a range only calls the original RenderInstanceSource::GetRenderInstanceTarget().
+
+        \code
+        tbb::parallel_for(TargetRange(source, 0, source->GetNumInstanceTargets(), 1024),
+            [](TargetRange &range)
+            {
+                range.Prefetch();
+                for (auto target : range)
+                    ... translate target ...
+            });
+        \endcode
+        */
+        class TargetRange {
+        public:
+            TargetRange(RenderInstanceSource *source, size_t begin, size_t end, size_t grainSize = 1)
+                : m_source(source), m_begin(begin), m_end(end), m_grainSize(grainSize ? grainSize : 1), m_context(nullptr) {}
+
+            /*! \brief Splitting constructor. Takes the upper half of <em>r</em>, which keeps the lower half.
+            The new range has no context, since it may be iterated by another thread. */
+            template <typename Split>
+            TargetRange(TargetRange &r, Split)
+                : m_source(r.m_source), m_begin(r.m_begin + (r.m_end - r.m_begin) / 2), m_end(r.m_end), m_grainSize(r.m_grainSize), m_context(nullptr)
+            {
+                r.m_end = m_begin;
+            }
+
+            bool   empty()        const { return m_begin >= m_end; }
+            bool   is_divisible() const { return m_end - m_begin > m_grainSize; }
+            size_t size()         const { return m_end - m_begin; }
+            size_t first()        const { return m_begin; }
+            size_t last()         const { return m_end; }
+            RenderInstanceSource *source() const { return m_source; }
+
+            //! \brief Tell the source that the calling thread is about to iterate this range. Extended sources only.
+            void Prefetch() const { if (!empty()) m_source->PrefetchTargets(m_begin, size()); }
+
+            //! \brief Retrieve targets through <em>context</em>, which must be owned by the iterating thread. May be nullptr. Extended sources only.
+            void           SetContext(TargetContext *context) { m_context = context; }
+            TargetContext *GetContext() const                 { return m_context; }
+
+            class Iterator {
+            public:
+                Iterator(RenderInstanceSource *item, TargetContext *context, size_t val) : m_item(item), m_context(context), m_i(val) {}
+
+                Iterator&             operator++() { m_i++; return *this; }
+                bool                  operator!=(const Iterator &iterator) { return m_i != iterator.m_i; }
+                RenderInstanceTarget *operator*() { return m_context ? m_item->GetRenderInstanceTargetInContext(m_i, *m_context) : m_item->GetRenderInstanceTarget(m_i); }
+            private:
+                RenderInstanceSource  *m_item;
+                TargetContext         *m_context;
+                size_t                 m_i;
+            };
+            Iterator begin() const { return Iterator(m_source, m_context, m_begin); }
+            Iterator end()   const { return Iterator(m_source, m_context, m_end); }
+
+        private:
+            RenderInstanceSource *m_source;
+            size_t                m_begin;
+            size_t                m_end;
+            size_t                m_grainSize;
+            TargetContext        *m_context;
+        };
+
+        /*! \brief Iterate all targets of a source in parallel.
+
+        Splits the targets into chunks of <em>grainSize</em> targets and runs <em>callback(TargetRange&)</em>
+        for each chunk on a pool of worker threads. Workers pull the next chunk from a shared counter, so
+        uneven chunks balance out. The range must be iterated by the callback on the calling thread only.
+        If <em>extended</em> is set, the range is already prefetched when the callback is invoked, and each
+        worker owns a TargetContext, which is set on the ranges it hands out. Otherwise only the original
+        functions of the source are called.
+
+        Renderers with their own scheduler (TBB, PPL, ...) should use TargetRange directly instead.
+
+        @param source The source whose targets to iterate
+        @param grainSize The number of targets per chunk
+        @param callback Called as callback(TargetRange &range) for each chunk
+        @param numThreads The number of worker threads. If 0, std::thread::hardware_concurrency() is used.
+        @param extended True if <em>source</em> belongs to an instancer obtained with GetExtendedRenderTimeInstancing()
+        */
+        template <typename Callback>
+        void ForEachTargetRange(RenderInstanceSource *source, size_t grainSize, Callback callback, unsigned numThreads = 0, bool extended = false)
+        {
+            size_t num = source->GetNumInstanceTargets();
+            if (grainSize == 0)
+                grainSize = 1;
+            size_t numChunks = (num + grainSize - 1) / grainSize;
+            if (numThreads == 0)
+                numThreads = std::thread::hardware_concurrency();
+            if (numThreads > numChunks)
+                numThreads = (unsigned)numChunks;
+
+            std::atomic<size_t> next(0);
+            auto run = [&](TargetContext *context)
+            {
+                for (size_t chunk = next++; chunk < numChunks; chunk = next++)
+                {
+                    size_t      first = chunk * grainSize;
+                    TargetRange range(source, first, (first + grainSize < num) ? first + grainSize : num, grainSize);
+                    if (context)
+                    {
+                        range.SetContext(context);
+                        range.Prefetch();
+                    }
+                    callback(range);
+                }
+            };
+            auto worker = [&]()
+            {
+                if (!extended)
+                    return run(nullptr);
+                TargetContext context(source);
+                run(&context);
+            };
+
+            if (numThreads <= 1)
+            {
+                worker();
+                return;
+            }
+            std::vector<std::thread> threads;
+            threads.reserve(numThreads - 1);
+            for (unsigned i = 1; i < numThreads; i++)
+                threads.emplace_back(worker);
+            worker();
+            for (auto &thread : threads)
+                thread.join();
+        }
+
+        /*! \brief Process all sources of an instancer, in parallel if the object allows it.
+
+        Runs <em>callback(RenderInstanceSource *source, size_t index)</em> once for each source. If the object
+        reports th_concurrentSources, the sources are distributed over a pool of worker threads, each source
+        being processed by a single thread. Otherwise, or if <em>extended</em> is not set, they are processed
+        one at a time on the calling thread.
+
+        @param instancer The instancer whose sources to process
+        @param callback Called as callback(RenderInstanceSource *source, size_t index) for each source
+        @param numThreads The number of worker threads. If 0, std::thread::hardware_concurrency() is used.
+        @param extended True if <em>instancer</em> was obtained with GetExtendedRenderTimeInstancing()
+        */
+        template <typename Callback>
+        void ForEachSource(RenderTimeInstancing *instancer, Callback callback, unsigned numThreads = 0, bool extended = false)
+        {
+            size_t num = instancer->GetNumInstanceSources();
+            if (!extended || !(instancer->GetThreadingFlags() & th_concurrentSources))
+                numThreads = 1;
+            else if (numThreads == 0)
+                numThreads = std::thread::hardware_concurrency();
+            if (numThreads > num)
+                numThreads = (unsigned)num;
+
+            std::atomic<size_t> next(0);
+            auto worker = [&]()
+            {
+                for (size_t i = next++; i < num; i = next++)
+                    callback(instancer->GetRenderInstanceSource(i), i);
+            };
+
+            if (numThreads <= 1)
+            {
+                worker();
+                return;
+            }
+            std::vector<std::thread> threads;
+            threads.reserve(numThreads - 1);
+            for (unsigned i = 1; i < numThreads; i++)
+                threads.emplace_back(worker);
+            worker();
+            for (auto &thread : threads)
+                thread.join();
+        }
+
+        inline TargetContext::TargetContext(RenderInstanceSource *source)
+            : pluginData(nullptr), m_source(source), m_storage(nullptr), m_size(source->GetTargetContextSize())
+        {
+            if (m_size)
+                m_storage = ::operator new(m_size);
+        }
+
+        inline TargetContext::~TargetContext()
+        {
+            m_source->ReleaseTargetContext(*this);
+            if (m_storage)
+                ::operator delete(m_storage);
+        }
+
+        inline void RenderTimeInstancing::UpdateInstanceDataEx(TimeValue t, Interval &valid, MotionBlurInfo &mbinfo, UpdateInfo &updinfo, View &view, TSTR plugin)
+        {
+            updinfo.flags      = UpdateInfo::uf_none;
+            updinfo.tmFormat   = UpdateInfo::tmf_matrix3;
+            updinfo.numSamples = 0;
+            updinfo.numEmitted = 0;
+            updinfo.numCulled  = 0;
+            UpdateInstanceData(t, valid, mbinfo, view, plugin);
+        }
+
+        inline void RenderTimeInstancing::BeginUpdateInstanceData(AsyncUpdate &request)
+        {
+            UpdateInstanceDataEx(request.t, request.valid, request.mbinfo, request.updinfo, *request.view, request.plugin);
+            if (request.onComplete)
+                request.onComplete(request);
+        }
+
+        /*! \brief Retrieves the data of a source and disposes of it correctly when going out of scope.
+
+        Deletes the data if the source set df_pluginMustDelete, and calls RenderInstanceSource::ReleaseData()
+        if it set df_borrowed.
+        \code
+        ScopedSourceData data(source);
+        if (data.Flags() & df_mesh)
+            TranslateMesh((Mesh*)data.Get());
+        \endcode
+        */
+        class ScopedSourceData {
+        public:
+            explicit ScopedSourceData(RenderInstanceSource *source)
+                : m_source(source), m_flags(source->GetFlags()), m_data(source->GetData()) {}
+            ~ScopedSourceData()
+            {
+                if (!m_data)
+                    return;
+                if (m_flags & df_borrowed)
+                    m_source->ReleaseData(m_data);
+                else if ((m_flags & df_pluginMustDelete) && (m_flags & df_mesh))
+                    delete (Mesh*)m_data;
+            }
+
+            ScopedSourceData(const ScopedSourceData&)            = delete;
+            ScopedSourceData &operator=(const ScopedSourceData&) = delete;
+
+            void     *Get()   const { return m_data; }
+            DataFlags Flags() const { return m_flags; }
+
+        private:
+            RenderInstanceSource *m_source;
+            DataFlags             m_flags;
+            void                 *m_data;
         };
 
+        /*! \brief Scatter the velocity map channel of a mesh into a per-vertex velocity array.
+
+        Implements the procedure described in RenderInstanceSource::GetVelocityMapChannel(). Vertices not
+        used by any face get a zero velocity. When the map faces use the same vertex indices as the mesh
+        faces, which is common, the map vertices are copied in one block instead, which writes each vertex
+        once rather than once per face corner. The result is the same either way.
+
+        @param mesh The mesh.
+        @param velocityMapChannel The map channel holding the velocities, or -1.
+        @param velocities Caller-owned buffer of mesh.numVerts velocities.
+        @return false if the mesh has no valid velocity map channel, in which case all velocities are zero.
+        */
+        inline bool ExtractVertexVelocities(Mesh &mesh, int velocityMapChannel, Point3 *velocities)
+        {
+            const int    numVerts = mesh.numVerts;
+            const int    numFaces = mesh.numFaces;
+            const Point3 zero(0.0f, 0.0f, 0.0f);
+            if (velocityMapChannel < 0 || !mesh.mapSupport(velocityMapChannel) || mesh.maps[velocityMapChannel].fnum != numFaces)
+            {
+                std::fill(velocities, velocities + numVerts, zero);
+                return false;
+            }
+
+            const MeshMap &map      = mesh.maps[velocityMapChannel];
+            const Face    *faces    = mesh.faces;
+            const TVFace  *mapFaces = map.tf;
+            const UVVert  *mapVerts = map.tv;
+
+            if (map.vnum == numVerts)
+            {
+                std::vector<unsigned char> used(numVerts, 0);
+                bool                       sameIndices = true;
+                for (int f = 0; f < numFaces && sameIndices; f++)
+                {
+                    const DWORD *v = faces[f].v;
+                    const DWORD *t = mapFaces[f].t;
+                    sameIndices = v[0] == t[0] && v[1] == t[1] && v[2] == t[2];
+                    used[v[0]] = used[v[1]] = used[v[2]] = 1;
+                }
+                if (sameIndices)
+                {
+                    std::copy(mapVerts, mapVerts + numVerts, velocities);
+                    for (int i = 0; i < numVerts; i++)
+                        if (!used[i])
+                            velocities[i] = zero;
+                    return true;
+                }
+            }
+
+            std::fill(velocities, velocities + numVerts, zero);
+            for (int f = 0; f < numFaces; f++)
+            {
+                const DWORD *v = faces[f].v;
+                const DWORD *t = mapFaces[f].t;
+                velocities[v[0]] = mapVerts[t[0]];
+                velocities[v[1]] = mapVerts[t[1]];
+                velocities[v[2]] = mapVerts[t[2]];
+            }
+            return true;
+        }
+
+        /*! \brief Get the per-vertex velocities of a source mesh.
+
+        Uses RenderInstanceSource::GetVertexVelocities() if <em>extended</em> is set and the object provides
+        them, and otherwise extracts them from the velocity map channel into <em>storage</em>.
+
+        @param source The source.
+        @param mesh The mesh returned by the GetData() function of the source.
+        @param storage Used to hold the velocities if they had to be extracted.
+        @param velocities Receives a view of one velocity per mesh vertex.
+        @param extended True if <em>source</em> belongs to an instancer obtained with GetExtendedRenderTimeInstancing()
+        @return false if the source has no velocities, in which case <em>velocities</em> is empty.
+        */
+        inline bool GetSourceVertexVelocities(RenderInstanceSource *source, Mesh &mesh, std::vector<Point3> &storage, ArrayView<Point3> &velocities, bool extended = false)
+        {
+            if (extended && source->GetVertexVelocities(velocities) && velocities.count == (size_t)mesh.numVerts)
+                return true;
+            velocities = ArrayView<Point3>();
+            storage.resize(mesh.numVerts);
+            if (storage.empty() || !ExtractVertexVelocities(mesh, source->GetVelocityMapChannel(), storage.data()))
+                return false;
+            velocities = ArrayView<Point3>(storage.data(), storage.size());
+            return true;
+        }
+
+        /*! \brief Resolve direct access to a custom data channel of a source, once.
+
+        Uses the direct layout descriptor (RenderInstanceSource::GetChannelOffset() with GetTargetRecords())
+        if the object provides it, and RenderInstanceSource::GetChannelView() otherwise. On success, values can
+        be read with ReadChannel() with no further calls into the object. May only be called for sources of an
+        instancer obtained with GetExtendedRenderTimeInstancing(). Other objects only provide the per-target functions.
+        \code
+        ChannelView view;
+        if (ResolveChannelView(source, channelInfo, view))
+            for (size_t i = 0; i < view.count; i++)
+                float f = ReadChannel<float>(view, i);
+        \endcode
+        @return false if neither is available, in which case the per-target or batch functions must be used.
+        */
+        inline bool ResolveChannelView(RenderInstanceSource *source, const ChannelInfo &channel, ChannelView &view)
+        {
+            int offset = source->GetChannelOffset(channel.channelID);
+            if (offset >= 0 && source->GetTargetRecords(view))
+            {
+                view.data = (const char*)view.data + offset;
+                return true;
+            }
+            return source->GetChannelView(channel.channelID, channel.type, view);
+        }
+
+        //! \brief Read the value of target <em>index</em> from a channel view. T must match the channel type.
+        template <typename T>
+        inline const T &ReadChannel(const ChannelView &view, size_t index)
+        {
+            return *(const T*)((const char*)view.data + index * view.stride);
+        }
+
+        /*! \brief Get the total number of leaf instances of an instancer, expanding nested instancers.
+
+        Each target of a source whose data is a nested instancer (DataFlags::df_instancer) counts as
+        all the leaf instances of that nested instancer. This is the number of instances a renderer
+        would have to create if it flattened the hierarchy.
+        */
+        inline unsigned __int64 GetTotalInstanceCount(RenderTimeInstancing *instancer)
+        {
+            unsigned __int64 total = 0;
+            for (auto source : *instancer)
+            {
+                unsigned __int64 perTarget = 1;
+                if (source->GetFlags() & df_instancer)
+                {
+                    auto nested = (RenderTimeInstancing*)source->GetData();
+                    perTarget   = nested ? GetTotalInstanceCount(nested) : 0;
+                }
+                total += perTarget * source->GetNumInstanceTargets();
+            }
+            return total;
+        }
+
         inline RenderTimeInstancing* GetRenderTimeInstancing(BaseObject* obj)
         {
             return (RenderTimeInstancing*)obj->GetInterface(RENDERTIME_INSTANCING_INTERFACE);
         }
+
+        /*! \brief Get the interface only if the object was built against a header with the extended functions.
+
+        Returns nullptr for objects built against a header without the extended functions. Those should be used
+        through GetRenderTimeInstancing() and the original functions only, which are safe to call on any object. Nested instancers returned by
+        RenderInstanceSource::GetData() with df_instancer come from the same plugin, and are extended if
+        their parent is.
+        \code
+        RenderTimeInstancing *instancer = GetExtendedRenderTimeInstancing(baseObject);
+        Capabilities caps = instancer ? instancer->GetCapabilities() : cap_none;
+        bool batchTMs = (caps & cap_batchTMs) != 0;
+        \endcode
+        */
+        inline RenderTimeInstancing* GetExtendedRenderTimeInstancing(BaseObject* obj)
+        {
+            return (RenderTimeInstancing*)obj->GetInterface(RENDERTIME_INSTANCING_EXTENDED_INTERFACE);
+        }
     }
 }
\ No newline at end of file
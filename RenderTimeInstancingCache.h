@@ -0,0 +1,697 @@
+/*Copyright (c) 2021, Autodesk Inc, All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this file ("RenderTimeInstancingCache.h") and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "RenderTimeInstancing.h"
+
+//standard headers
+#include <windows.h>
+#include <tchar.h>
+#include <stdio.h>
+#include <functional>
+#include <vector>
+
+namespace MaxSDK
+{
+    namespace RenderTimeInstancing
+    {
+        /*! \brief An on-disk cache of the complete state of a RenderTimeInstancing, for reuse across render nodes.
+
+            A scatter is deterministic, so instead of every render node evaluating it for every frame, it can be
+            evaluated once, written with WriteInstanceCache(), and then loaded by all nodes through an InstanceCache,
+            which exposes it back through the RenderTimeInstancing interface. The file is columnar and read through a
+            memory mapping, so loading is zero-copy: transforms and custom channels are served straight from the
+            mapped file, and the operating system shares the pages between processes.
+
+            The cache stores, per source, its ContentHash, velocity map channel, local bounds, and for each target its
+            GetID(), GetInstanceID(), transforms, velocity and spin (if MotionBlurInfo::mb_velocityspin was set), and
+            the values of all custom channels. Geometry is not stored: an InstanceCache identifies each source by its
+            ContentHash, and a renderer supplies the data itself (see InstanceCache::SetDataResolver()), typically from
+            its own geometry cache. Per-instance material, material ID and UVW overrides are not stored either, since
+            they reference scene objects.
+
+            Values are stored in the in-memory layout of the Max SDK types (Matrix3, Point3, AngAxis, ...), so a file
+            can be shared by all nodes running the same platform.
+
+            Usage example:
+            \code
+            // Once, on one node, after UpdateInstanceData()
+            WriteInstanceCache(instancer, _T("\\\\server\\cache\\forest_0042.rtic"), mblur, valid);
+
+            // On every render node
+            InstanceCache cache;
+            if (cache.Open(_T("\\\\server\\cache\\forest_0042.rtic")))
+            {
+                cache.SetDataResolver([&](const ContentHash &hash, DataFlags &flags) { return myGeometryCache.Find(hash, flags); });
+                cache.UpdateInstanceData(t, valid, mblur, view, _T("myPlugin"));
+                ... use cache as any other RenderTimeInstancing ...
+            }
+            \endcode
+        */
+        namespace Cache
+        {
+            /*! \brief Current file format version */
+            const unsigned int kVersion = 1;
+
+            /*! \brief File header, at offset 0 */
+            struct FileHeader {
+                char             magic[8];           //!< \brief "RTICACHE"
+                unsigned int     version;            //!< \brief kVersion
+                unsigned int     numSources;         //!< \brief Number of SourceRecord entries
+                unsigned int     numChannels;        //!< \brief Number of ChannelRecord entries
+                int              mbFlags;            //!< \brief MotionBlurInfo::flags at the time of writing
+                int              shutterStart;       //!< \brief MotionBlurInfo::shutterInterval at the time of writing
+                int              shutterEnd;
+                int              validStart;         //!< \brief The validity interval of the data
+                int              validEnd;
+                unsigned __int64 sourceTableOffset;  //!< \brief File offset of the SourceRecord table
+                unsigned __int64 channelTableOffset; //!< \brief File offset of the ChannelRecord table
+            };
+
+            /*! \brief Description of a custom data channel. The ChannelID of a channel in an InstanceCache is its index. */
+            struct ChannelRecord {
+                wchar_t name[64]; //!< \brief ChannelInfo::name, truncated
+                int     type;     //!< \brief ChannelInfo::type
+                int     size;     //!< \brief Size of each value in bytes
+            };
+
+            /*! \brief Description of a source, and the file offsets of its target columns.
+                Each column holds one value per target, except <em>tms</em> which holds numSamples per target.
+                An offset of 0 means the column is not present. */
+            struct SourceRecord {
+                ContentHash      hash;               //!< \brief RenderInstanceSource::GetContentHash()
+                unsigned __int64 numTargets;         //!< \brief Number of targets
+                int              numSamples;         //!< \brief Number of transforms per target
+                int              flags;              //!< \brief RenderInstanceSource::GetFlags() at the time of writing
+                int              velocityMapChannel; //!< \brief RenderInstanceSource::GetVelocityMapChannel()
+                int              pad;
+                float            bounds[6];          //!< \brief RenderInstanceSource::GetLocalBounds(), min then max
+                unsigned __int64 ids;                //!< \brief __int64 column of RenderInstanceTarget::GetID()
+                unsigned __int64 instanceIDs;        //!< \brief __int64 column of RenderInstanceTarget::GetInstanceID()
+                unsigned __int64 tms;                //!< \brief Matrix3 column
+                unsigned __int64 velocities;         //!< \brief Point3 column
+                unsigned __int64 spins;              //!< \brief AngAxis column
+                unsigned __int64 channels;           //!< \brief Table of FileHeader::numChannels offsets, one column per channel
+            };
+
+            //! \brief Write zero bytes until the file position is 16-byte aligned, and return that position
+            inline unsigned __int64 AlignFile(FILE *file)
+            {
+                static const char zeros[16] = {};
+                __int64 pos = _ftelli64(file);
+                if (pos % 16)
+                {
+                    fwrite(zeros, 1, (size_t)(16 - pos % 16), file);
+                    pos += 16 - pos % 16;
+                }
+                return (unsigned __int64)pos;
+            }
+        }
+
+        /*! \brief Write the state of an instancer to a cache file.
+
+        UpdateInstanceData() must have been called on the instancer, with <em>mbinfo</em> and <em>valid</em>
+        being the values it returned. Transforms are written with GetTMsBatch() and channels with
+        GetChannelBatch(), so objects implementing those natively are written efficiently. Data is looked up
+        by its content hash when the cache is loaded (see InstanceCache::SetDataResolver()), so every source
+        must implement RenderInstanceSource::GetContentHash().
+
+        @param instancer The instancer to write
+        @param filename The file to create
+        @param mbinfo The MotionBlurInfo returned by UpdateInstanceData()
+        @param valid The validity interval returned by UpdateInstanceData()
+        @param numSamples The UpdateInfo::numSamples returned by UpdateInstanceDataEx(), or 0 to use the most
+               any target of a source has
+        @return true on success, false if the file could not be written or a source has no content hash
+        */
+        inline bool WriteInstanceCache(RenderTimeInstancing *instancer, const TCHAR *filename, const MotionBlurInfo &mbinfo, const Interval &valid, int numSamples = 0)
+        {
+            using namespace Cache;
+
+            MaxSDK::Array<ChannelInfo> channels = instancer->GetChannels();
+            size_t                     numSources = instancer->GetNumInstanceSources();
+            std::vector<SourceRecord>  sources(numSources);
+
+            // Without a hash the data of a source could not be found again when the cache is loaded
+            for (size_t s = 0; s < numSources; s++)
+                if (!instancer->GetRenderInstanceSource(s)->GetContentHash(sources[s].hash) || sources[s].hash.IsNull())
+                    return false;
+
+            FILE *file = _tfopen(filename, _T("wb"));
+            if (!file)
+                return false;
+
+            FileHeader header = {};
+            memcpy(header.magic, "RTICACHE", 8);
+            header.version      = kVersion;
+            header.numSources   = (unsigned int)numSources;
+            header.numChannels  = (unsigned int)channels.length();
+            header.mbFlags      = mbinfo.flags;
+            header.shutterStart = mbinfo.shutterInterval.Start();
+            header.shutterEnd   = mbinfo.shutterInterval.End();
+            header.validStart   = valid.Start();
+            header.validEnd     = valid.End();
+
+            // Placeholders, rewritten at the end once all offsets are known
+            fwrite(&header, sizeof(header), 1, file);
+            header.channelTableOffset = AlignFile(file);
+            for (size_t c = 0; c < channels.length(); c++)
+            {
+                ChannelRecord record = {};
+                wcsncpy(record.name, channels[c].name.data(), 63);
+                record.type = channels[c].type;
+                record.size = (channels[c].type == ChannelInfo::typeCustom) ? channels[c].size : (int)GetChannelTypeSize(channels[c].type);
+                fwrite(&record, sizeof(record), 1, file);
+            }
+            header.sourceTableOffset = AlignFile(file);
+            fwrite(sources.data(), sizeof(SourceRecord), numSources, file);
+
+            const size_t      chunkSize = 4096;
+            std::vector<char> buffer;
+            bool              ok        = true;
+            for (size_t s = 0; s < numSources && ok; s++)
+            {
+                RenderInstanceSource *source = instancer->GetRenderInstanceSource(s);
+                SourceRecord         &record = sources[s];
+                size_t                num    = source->GetNumInstanceTargets();
+                Box3                  bounds = source->GetLocalBounds();
+
+                record.numTargets         = num;
+                record.flags              = source->GetFlags();
+                record.velocityMapChannel = source->GetVelocityMapChannel();
+                for (int i = 0; i < 3; i++)
+                {
+                    record.bounds[i]     = bounds.pmin[i];
+                    record.bounds[i + 3] = bounds.pmax[i];
+                }
+
+                // Number of samples: as negotiated, otherwise the most any target has
+                record.numSamples = numSamples > 0 ? numSamples : 1;
+                if (numSamples <= 0 && !source->IsAllStatic())
+                    for (auto target : *source)
+                    {
+                        int n = (int)target->GetTMs().length();
+                        if (n > record.numSamples)
+                            record.numSamples = n;
+                    }
+
+                record.ids = AlignFile(file);
+                for (size_t i = 0; i < num; i++)
+                {
+                    __int64 id = source->GetRenderInstanceTarget(i)->GetID();
+                    fwrite(&id, sizeof(id), 1, file);
+                }
+                record.instanceIDs = AlignFile(file);
+                for (size_t i = 0; i < num; i++)
+                {
+                    __int64 id = source->GetRenderInstanceTarget(i)->GetInstanceID();
+                    fwrite(&id, sizeof(id), 1, file);
+                }
+
+                record.tms = AlignFile(file);
+                buffer.resize(chunkSize * record.numSamples * sizeof(Matrix3));
+                for (size_t first = 0; first < num; first += chunkSize)
+                {
+                    size_t count = source->GetTMsBatch(first, chunkSize, record.numSamples, (Matrix3*)buffer.data());
+                    fwrite(buffer.data(), sizeof(Matrix3) * record.numSamples, count, file);
+                }
+
+                if (mbinfo.flags & MotionBlurInfo::mb_velocityspin)
+                {
+                    record.velocities = AlignFile(file);
+                    for (size_t i = 0; i < num; i++)
+                    {
+                        Point3 velocity = source->GetRenderInstanceTarget(i)->GetVelocity();
+                        fwrite(&velocity, sizeof(velocity), 1, file);
+                    }
+                    record.spins = AlignFile(file);
+                    for (size_t i = 0; i < num; i++)
+                    {
+                        AngAxis spin = source->GetRenderInstanceTarget(i)->GetSpin();
+                        fwrite(&spin, sizeof(spin), 1, file);
+                    }
+                }
+
+                std::vector<unsigned __int64> channelOffsets(channels.length());
+                for (size_t c = 0; c < channels.length(); c++)
+                {
+                    const ChannelInfo &channel = channels[c];
+                    size_t size = (channel.type == ChannelInfo::typeCustom) ? channel.size : GetChannelTypeSize(channel.type);
+                    channelOffsets[c] = AlignFile(file);
+                    buffer.resize(chunkSize * size);
+                    for (size_t first = 0; first < num; first += chunkSize)
+                    {
+                        size_t count = source->GetChannelBatch(channel.channelID, channel.type, first, chunkSize, buffer.data(), size, size);
+                        fwrite(buffer.data(), size, count, file);
+                    }
+                }
+                record.channels = AlignFile(file);
+                fwrite(channelOffsets.data(), sizeof(unsigned __int64), channelOffsets.size(), file);
+
+                ok = !ferror(file);
+            }
+
+            // Rewrite the header and the source table with the final offsets
+            _fseeki64(file, 0, SEEK_SET);
+            fwrite(&header, sizeof(header), 1, file);
+            _fseeki64(file, (__int64)header.sourceTableOffset, SEEK_SET);
+            fwrite(sources.data(), sizeof(SourceRecord), numSources, file);
+
+            ok = ok && !ferror(file);
+            return (fclose(file) == 0) && ok;
+        }
+
+        class InstanceCache;
+
+        /*! \brief A source of an InstanceCache. Serves all data straight from the mapped file. */
+        class CachedInstanceSource : public RenderInstanceSource
+        {
+        public:
+            CachedInstanceSource() : m_cache(nullptr), m_record(nullptr), m_resolved(false), m_data(nullptr), m_flags(df_none) {}
+
+            DataFlags GetFlags() override;
+            void     *GetData()  override;
+
+            int    GetVelocityMapChannel() override { return m_record->velocityMapChannel; }
+            size_t GetNumInstanceTargets() override { return (size_t)m_record->numTargets; }
+
+            RenderInstanceTarget *GetRenderInstanceTarget(size_t index) override;
+
+            OverrideFlags GetOverrideFlags() override { return of_none; }
+            bool          IsAllStatic()      override { return m_record->numSamples == 1; }
+
+            bool GetContentHash(ContentHash &hash) override
+            {
+                hash = m_record->hash;
+                return !hash.IsNull();
+            }
+
+            Box3 GetLocalBounds() override
+            {
+                return Box3(Point3(m_record->bounds[0], m_record->bounds[1], m_record->bounds[2]),
+                            Point3(m_record->bounds[3], m_record->bounds[4], m_record->bounds[5]));
+            }
+
+            //! \brief Only the bounds are stored, the rest of the metadata is unknown
+            bool GetMetadata(SourceMetadata &metadata) override
+            {
+                metadata.bounds = GetLocalBounds();
+                return !metadata.bounds.IsEmpty();
+            }
+
+            size_t GetWorldBoundsBatch(size_t first, size_t count, Box3 *out, bool motionBlur = true) override
+            {
+                count = ClampTargetRange(first, count);
+                Box3           local = GetLocalBounds();
+                const Matrix3 *tms   = TMs();
+                int            n     = m_record->numSamples;
+                int            used  = motionBlur ? n : 1;
+                for (size_t i = 0; i < count; i++)
+                {
+                    out[i].Init();
+                    if (local.IsEmpty())
+                        continue;
+                    const Matrix3 *targetTMs = tms + (first + i) * n;
+                    for (int s = 0; s < used; s++)
+                        out[i] += local * targetTMs[s];
+                }
+                return count;
+            }
+
+            size_t GetTMsBatch(size_t first, size_t count, int numSamples, Matrix3 *out) override
+            {
+                count = ClampTargetRange(first, count);
+                const Matrix3 *tms = TMs();
+                int            n   = m_record->numSamples;
+                if (numSamples == n)
+                {
+                    memcpy(out, tms + first * n, sizeof(Matrix3) * count * n);
+                    return count;
+                }
+                for (size_t i = 0; i < count; i++)
+                    for (int s = 0; s < numSamples; s++)
+                        out[i * numSamples + s] = tms[(first + i) * n + NearestSample(s, numSamples, n)];
+                return count;
+            }
+
+            size_t GetMotionBatchSoA(size_t first, size_t count, Matrix3 *tms, Point3 *velocities, AngAxis *spins) override
+            {
+                count = ClampTargetRange(first, count);
+                if (tms)
+                    GetTMsBatch(first, count, 1, tms);
+                const Point3  *srcVelocities = Column<Point3>(m_record->velocities);
+                const AngAxis *srcSpins      = Column<AngAxis>(m_record->spins);
+                for (size_t i = 0; i < count; i++)
+                {
+                    if (velocities) velocities[i] = srcVelocities ? srcVelocities[first + i] : Point3(0.0f, 0.0f, 0.0f);
+                    if (spins)      spins[i]      = srcSpins ? srcSpins[first + i] : AngAxis(Point3(0.0f, 0.0f, 1.0f), 0.0f);
+                }
+                return count;
+            }
+
+            bool GetChannelView(ChannelID channel, ChannelInfo::TypeID type, ChannelView &view) override;
+
+        private:
+            friend class InstanceCache;
+            friend class CachedInstanceTarget;
+
+            InstanceCache             *m_cache;
+            const Cache::SourceRecord *m_record;
+            bool                       m_resolved; //!< Whether the data resolver has been called for this source
+            void                      *m_data;
+            DataFlags                  m_flags;
+
+            void Resolve();
+
+            template <typename T>
+            const T *Column(unsigned __int64 offset) const;
+
+            const Matrix3 *TMs() const { return Column<Matrix3>(m_record->tms); }
+        };
+
+        /*! \brief A target of an InstanceCache */
+        class CachedInstanceTarget : public RenderInstanceTarget
+        {
+        public:
+            CachedInstanceTarget() : m_source(nullptr), m_index(0) {}
+
+            void Set(CachedInstanceSource *source, size_t index) { m_source = source; m_index = index; }
+
+            void   *GetCustomData  (ChannelID channel) override;
+            float   GetCustomFloat (ChannelID channel) override { return GetValue(channel, ChannelInfo::typeFloat,  0.0f); }
+            Point3  GetCustomVector(ChannelID channel) override { return GetValue(channel, ChannelInfo::typeVector, Point3(0.0f, 0.0f, 0.0f)); }
+            Color   GetCustomColor (ChannelID channel) override { return GetValue(channel, ChannelInfo::typeColor,  Color(0.0f, 0.0f, 0.0f)); }
+            Matrix3 GetCustomTM    (ChannelID channel) override
+            {
+                Matrix3 identity;
+                identity.IdentityMatrix();
+                return GetValue(channel, ChannelInfo::typeTM, identity);
+            }
+
+            __int64 GetID()         override { return m_source->Column<__int64>(m_source->m_record->ids)[m_index]; }
+            __int64 GetInstanceID() override { return m_source->Column<__int64>(m_source->m_record->instanceIDs)[m_index]; }
+            Mtl    *GetMtl()        override { return nullptr; }
+
+            MaxSDK::Array<InstanceMatIDInfo> GetMatIDs()     override { return MaxSDK::Array<InstanceMatIDInfo>(); }
+            MaxSDK::Array<InstanceUVWInfo>   GetUVWsVec()    override { return MaxSDK::Array<InstanceUVWInfo>(); }
+            ArrayView<InstanceMatIDInfo>     GetMatIDsView() override { return ArrayView<InstanceMatIDInfo>(); }
+            ArrayView<InstanceUVWInfo>       GetUVWsView()   override { return ArrayView<InstanceUVWInfo>(); }
+
+            MaxSDK::Array<Matrix3> GetTMs() override
+            {
+                int                    n   = m_source->m_record->numSamples;
+                const Matrix3         *tms = m_source->TMs() + m_index * n;
+                MaxSDK::Array<Matrix3> result;
+                result.setLengthUsed(n);
+                for (int s = 0; s < n; s++)
+                    result[s] = tms[s];
+                return result;
+            }
+            Matrix3 GetTM()    override { return m_source->TMs()[m_index * m_source->m_record->numSamples]; }
+            bool    IsStatic() override { return m_source->m_record->numSamples == 1; }
+
+            Point3 GetVelocity() override
+            {
+                const Point3 *velocities = m_source->Column<Point3>(m_source->m_record->velocities);
+                return velocities ? velocities[m_index] : Point3(0.0f, 0.0f, 0.0f);
+            }
+            AngAxis GetSpin() override
+            {
+                const AngAxis *spins = m_source->Column<AngAxis>(m_source->m_record->spins);
+                return spins ? spins[m_index] : AngAxis(Point3(0.0f, 0.0f, 1.0f), 0.0f);
+            }
+
+        private:
+            CachedInstanceSource *m_source;
+            size_t                m_index;
+
+            template <typename T>
+            T GetValue(ChannelID channel, ChannelInfo::TypeID type, const T &def)
+            {
+                ChannelView view;
+                if (!m_source->GetChannelView(channel, type, view))
+                    return def;
+                return *(const T*)((const char*)view.data + m_index * view.stride);
+            }
+        };
+
+        /*! \brief Exposes a cache file written by WriteInstanceCache() through the RenderTimeInstancing interface.
+            \see Namespace MaxSDK::RenderTimeInstancing::Cache */
+        class InstanceCache : public RenderTimeInstancing
+        {
+        public:
+            /*! \brief Supplies the data of a source, identified by its content hash.
+                Returns the pointer GetData() should return, and sets the flags GetFlags() should return. On input,
+                <em>flags</em> holds the type flags of the source when the cache was written. The resolver is called
+                at most once per source, and the data it returns must stay valid until Close() or the next
+                SetDataResolver(). It must therefore not set df_pluginMustDelete. */
+            typedef std::function<void*(const ContentHash &hash, DataFlags &flags)> DataResolver;
+
+            InstanceCache() : m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr), m_base(nullptr), m_size(0) {}
+            ~InstanceCache() { Close(); }
+
+            /*! \brief Map a cache file. Returns false if it can not be opened or is not a valid cache. */
+            bool Open(const TCHAR *filename)
+            {
+                Close();
+                m_file = CreateFile(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                LARGE_INTEGER size;
+                if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size) || size.QuadPart < (LONGLONG)sizeof(Cache::FileHeader))
+                {
+                    Close();
+                    return false;
+                }
+                m_size    = (unsigned __int64)size.QuadPart;
+                m_mapping = CreateFileMapping(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                m_base    = m_mapping ? (const char*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+                if (!m_base || !Validate())
+                {
+                    Close();
+                    return false;
+                }
+
+                const Cache::FileHeader &header  = Header();
+                auto                     records = (const Cache::SourceRecord*)(m_base + header.sourceTableOffset);
+                m_sources.resize(header.numSources);
+                for (size_t s = 0; s < m_sources.size(); s++)
+                {
+                    m_sources[s]          = CachedInstanceSource();
+                    m_sources[s].m_cache  = this;
+                    m_sources[s].m_record = &records[s];
+                }
+                return true;
+            }
+
+            //! \brief Unmap the cache file
+            void Close()
+            {
+                m_sources.clear();
+                if (m_base)
+                    UnmapViewOfFile(m_base);
+                if (m_mapping)
+                    CloseHandle(m_mapping);
+                if (m_file != INVALID_HANDLE_VALUE)
+                    CloseHandle(m_file);
+                m_file    = INVALID_HANDLE_VALUE;
+                m_mapping = nullptr;
+                m_base    = nullptr;
+                m_size    = 0;
+            }
+
+            //! \brief Set the function supplying the data of the sources. Without it, GetData() returns nullptr.
+            void SetDataResolver(const DataResolver &resolver)
+            {
+                m_resolver = resolver;
+                for (auto &source : m_sources)
+                {
+                    source.m_resolved = false;
+                    source.m_data     = nullptr;
+                    source.m_flags    = df_none;
+                }
+            }
+
+            /*! \brief Returns the cached MotionBlurInfo and validity. Any culling or other requests are not honored,
+                since the cached data is already evaluated. */
+            void UpdateInstanceData(TimeValue t, Interval &valid, MotionBlurInfo &mbinfo, View &view, TSTR plugin) override
+            {
+                if (!m_base)
+                    return;
+                const Cache::FileHeader &header = Header();
+                valid                  = Interval(header.validStart, header.validEnd);
+                mbinfo.flags           = (MotionBlurInfo::MBFlags)header.mbFlags;
+                mbinfo.shutterInterval = Interval(header.shutterStart, header.shutterEnd);
+            }
+
+            //! \brief Does nothing, the data stays mapped until Close()
+            void ReleaseInstanceData() override {}
+
+            MaxSDK::Array<ChannelInfo> GetChannels() override
+            {
+                MaxSDK::Array<ChannelInfo> channels;
+                for (unsigned int c = 0; m_base && c < Header().numChannels; c++)
+                {
+                    const Cache::ChannelRecord &record = Channel(c);
+                    ChannelInfo info;
+                    info.name      = TSTR(record.name);
+                    info.type      = (ChannelInfo::TypeID)record.type;
+                    info.channelID = (ChannelID)c;
+                    info.size      = record.size;
+                    channels.append(info);
+                }
+                return channels;
+            }
+
+            ChannelID GetChannelID(TSTR name, TypeID type) override
+            {
+                for (unsigned int c = 0; m_base && c < Header().numChannels; c++)
+                    if (Channel(c).type == (int)type && name == TSTR(Channel(c).name))
+                        return (ChannelID)c;
+                return -1;
+            }
+
+            size_t                GetNumInstanceSources()               override { return m_sources.size(); }
+            RenderInstanceSource *GetRenderInstanceSource(size_t index) override { return &m_sources[index]; }
+
+            Capabilities GetCapabilities() override
+            {
+                return (Capabilities)(cap_batchTMs | cap_motionBatch | cap_channelViews | cap_overrideViews
+                                      | cap_contentHash | cap_metadata);
+            }
+
+        private:
+            friend class CachedInstanceSource;
+            friend class CachedInstanceTarget;
+
+            HANDLE                            m_file;
+            HANDLE                            m_mapping;
+            const char                       *m_base;
+            unsigned __int64                  m_size;
+            std::vector<CachedInstanceSource> m_sources;
+            DataResolver                      m_resolver;
+
+            const Cache::FileHeader    &Header()                 const { return *(const Cache::FileHeader*)m_base; }
+            const Cache::ChannelRecord &Channel(unsigned int c)  const { return ((const Cache::ChannelRecord*)(m_base + Header().channelTableOffset))[c]; }
+
+            //! Check that the header, all tables and all columns are inside the file, and that the channel records are consistent
+            bool Validate() const
+            {
+                const Cache::FileHeader &header = Header();
+                if (memcmp(header.magic, "RTICACHE", 8) != 0 || header.version != Cache::kVersion)
+                    return false;
+                if (!InFile(header.channelTableOffset, header.numChannels, sizeof(Cache::ChannelRecord)) ||
+                    !InFile(header.sourceTableOffset,  header.numSources,  sizeof(Cache::SourceRecord)))
+                    return false;
+                for (unsigned int c = 0; c < header.numChannels; c++)
+                {
+                    const Cache::ChannelRecord &record = Channel(c);
+                    ChannelInfo::TypeID         type   = (ChannelInfo::TypeID)record.type;
+                    if (record.name[63] != 0 || record.size <= 0 ||
+                        (type != ChannelInfo::typeCustom && (size_t)record.size != GetChannelTypeSize(type)))
+                        return false;
+                }
+                auto records = (const Cache::SourceRecord*)(m_base + header.sourceTableOffset);
+                for (unsigned int s = 0; s < header.numSources; s++)
+                {
+                    const Cache::SourceRecord &r = records[s];
+                    unsigned __int64           n = r.numTargets;
+                    if (r.numSamples < 1 ||
+                        !InFile(r.ids,         n, sizeof(__int64)) ||
+                        !InFile(r.instanceIDs, n, sizeof(__int64)) ||
+                        !InFile(r.tms,         n, r.numSamples * sizeof(Matrix3)) ||
+                        (r.velocities && !InFile(r.velocities, n, sizeof(Point3))) ||
+                        (r.spins      && !InFile(r.spins,      n, sizeof(AngAxis))) ||
+                        !InFile(r.channels, header.numChannels, sizeof(unsigned __int64)))
+                        return false;
+                    auto channelOffsets = (const unsigned __int64*)(m_base + r.channels);
+                    for (unsigned int c = 0; c < header.numChannels; c++)
+                        if (!InFile(channelOffsets[c], n, (unsigned __int64)Channel(c).size))
+                            return false;
+                }
+                return true;
+            }
+
+            //! Check that <em>count</em> values of <em>size</em> bytes at <em>offset</em> are inside the file, without overflowing
+            bool InFile(unsigned __int64 offset, unsigned __int64 count, unsigned __int64 size) const
+            {
+                if (offset == 0 || offset > m_size)
+                    return false;
+                return count == 0 || (size > 0 && count <= (m_size - offset) / size);
+            }
+        };
+
+        template <typename T>
+        inline const T *CachedInstanceSource::Column(unsigned __int64 offset) const
+        {
+            return offset ? (const T*)(m_cache->m_base + offset) : nullptr;
+        }
+
+        inline void CachedInstanceSource::Resolve()
+        {
+            if (m_resolved)
+                return;
+            m_resolved = true;
+            m_flags    = (DataFlags)(m_record->flags & ~(df_pluginMustDelete | df_borrowed));
+            m_data     = m_cache->m_resolver ? m_cache->m_resolver(m_record->hash, m_flags) : nullptr;
+            if (!m_data)
+                m_flags = df_none;
+        }
+
+        inline DataFlags CachedInstanceSource::GetFlags()
+        {
+            Resolve();
+            return m_flags;
+        }
+
+        inline void *CachedInstanceSource::GetData()
+        {
+            Resolve();
+            return m_data;
+        }
+
+        inline RenderInstanceTarget *CachedInstanceSource::GetRenderInstanceTarget(size_t index)
+        {
+            // Legal, since a thread may only access one target at a time
+            static thread_local CachedInstanceTarget target;
+            target.Set(this, index);
+            return &target;
+        }
+
+        inline bool CachedInstanceSource::GetChannelView(ChannelID channel, ChannelInfo::TypeID type, ChannelView &view)
+        {
+            if (channel < 0 || channel >= (int)m_cache->Header().numChannels || m_cache->Channel(channel).type != type)
+                return false;
+            view.data   = Column<char>(Column<unsigned __int64>(m_record->channels)[channel]);
+            view.stride = m_cache->Channel(channel).size;
+            view.count  = (size_t)m_record->numTargets;
+            return true;
+        }
+
+        inline void *CachedInstanceTarget::GetCustomData(ChannelID channel)
+        {
+            if (channel < 0 || channel >= (int)m_source->m_cache->Header().numChannels)
+                return nullptr;
+            ChannelView view;
+            m_source->GetChannelView(channel, (ChannelInfo::TypeID)m_source->m_cache->Channel(channel).type, view);
+            // The data is read-only, the pointer is only non-const to match the interface
+            return (char*)view.data + m_index * view.stride;
+        }
+    }
+}
@@ -0,0 +1,670 @@
+/*Copyright (c) 2021, Autodesk Inc, All Rights Reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this file ("RenderTimeInstancingMock.h") and associated documentation files (the "Software"),
+to deal in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "RenderTimeInstancing.h"
+
+//standard headers
+#include <chrono>
+#include <cmath>
+#include <new>
+#include <vector>
+
+namespace MaxSDK
+{
+    namespace RenderTimeInstancing
+    {
+        /*! \brief A reference implementation of the RenderTimeInstancing interface, and a set of
+                  micro-benchmarks measuring traversal throughput through it.
+
+            MockInstancer generates a configurable, deterministic set of sources and targets, stored
+            contiguously per source. It serves both as an example of how an object can implement the
+            interface (including the batch functions), and as a stand-in instancer for renderers that
+            want to measure or test their side of the contract without a real scatter.
+
+            Usage example:
+            \code
+            Mock::Config config;
+            config.numSources          = 4;
+            config.numTargetsPerSource = 1000000;
+            config.numFloatChannels    = 2;
+
+            Mock::MockInstancer instancer(config);
+            MotionBlurInfo mblur(Interval(0, 160));
+            Interval valid = FOREVER;
+            instancer.UpdateInstanceData(0, valid, mblur, view, _T("myPlugin"));
+
+            Mock::BenchmarkResult r = Mock::BenchmarkGetTMs(instancer);
+            DebugPrint(_T("%s: %.1f M instances/sec\n"), r.name, r.InstancesPerSecond() / 1e6);
+            \endcode
+        */
+        namespace Mock
+        {
+            /*! \brief Configuration of a MockInstancer */
+            struct Config {
+                size_t numSources;           //!< \brief Number of sources
+                size_t numTargetsPerSource;  //!< \brief Number of targets of each source
+                int    numMotionSamples;     //!< \brief Number of transforms returned by GetTMs() when motion blur is on
+                bool   velocitySpin;         //!< \brief Whether the instancer provides velocity and spin (MBFlags::mb_velocityspin)
+                int    numFloatChannels;     //!< \brief Number of custom float channels, named "float0", "float1", ...
+                int    numVectorChannels;    //!< \brief Number of custom vector channels, named "vector0", ...
+                int    numColorChannels;     //!< \brief Number of custom color channels, named "color0", ...
+                int    numTMChannels;        //!< \brief Number of custom TM channels, named "tm0", ...
+                Mesh  *mesh;                 //!< \brief Mesh returned by every source's GetData(), not owned. May be nullptr.
+                float  extent;               //!< \brief Targets are scattered in a cube of this half-size around the origin
+
+                Config()
+                    : numSources(1), numTargetsPerSource(1000), numMotionSamples(2), velocitySpin(false),
+                      numFloatChannels(0), numVectorChannels(0), numColorChannels(0), numTMChannels(0),
+                      mesh(nullptr), extent(1000.0f) {}
+            };
+
+            class MockInstanceSource;
+
+            //! \brief Return an identity transform
+            inline Matrix3 IdentityTM()
+            {
+                Matrix3 tm;
+                tm.IdentityMatrix();
+                return tm;
+            }
+
+            /*! \brief Target of a MockInstanceSource. A view of one index of the source's arrays. */
+            class MockInstanceTarget : public RenderInstanceTarget
+            {
+            public:
+                MockInstanceTarget() : m_source(nullptr), m_index(0) {}
+
+                void Set(MockInstanceSource *source, size_t index) { m_source = source; m_index = index; }
+
+                void   *GetCustomData  (ChannelID channel) override;
+                float   GetCustomFloat (ChannelID channel) override;
+                Point3  GetCustomVector(ChannelID channel) override;
+                Color   GetCustomColor (ChannelID channel) override;
+                Matrix3 GetCustomTM    (ChannelID channel) override;
+
+                __int64 GetID()         override;
+                __int64 GetInstanceID() override;
+                Mtl    *GetMtl()        override { return nullptr; }
+
+                MaxSDK::Array<InstanceMatIDInfo> GetMatIDs()     override { return MaxSDK::Array<InstanceMatIDInfo>(); }
+                MaxSDK::Array<InstanceUVWInfo>   GetUVWsVec()    override { return MaxSDK::Array<InstanceUVWInfo>(); }
+                ArrayView<InstanceMatIDInfo>     GetMatIDsView() override { return ArrayView<InstanceMatIDInfo>(); }
+                ArrayView<InstanceUVWInfo>       GetUVWsView()   override { return ArrayView<InstanceUVWInfo>(); }
+
+                MaxSDK::Array<Matrix3> GetTMs()      override;
+                Matrix3                GetTM()       override;
+                Point3                 GetVelocity() override;
+                AngAxis                GetSpin()     override;
+                bool                   IsStatic()    override;
+
+            private:
+                MockInstanceSource *m_source;
+                size_t              m_index;
+            };
+
+            /*! \brief Source of a MockInstancer. Stores all target data in contiguous arrays. */
+            class MockInstanceSource : public RenderInstanceSource
+            {
+            public:
+                DataFlags GetFlags()              override { return m_mesh ? df_mesh : df_none; }
+                void     *GetData()               override { return m_mesh; }
+                int       GetVelocityMapChannel() override { return -1; }
+
+                OverrideFlags GetOverrideFlags() override { return of_none; }
+                bool          IsAllStatic()      override { return m_numSamples == 1; }
+
+                bool GetMetadata(SourceMetadata &metadata) override
+                {
+                    metadata.bounds = m_bounds;
+                    if (m_mesh)
+                    {
+                        metadata.numVerts = m_mesh->numVerts;
+                        metadata.numFaces = m_mesh->numFaces;
+                    }
+                    return true;
+                }
+
+                bool GetContentHash(ContentHash &hash) override
+                {
+                    hash = m_mesh ? ComputeMeshHash(*m_mesh) : ContentHash();
+                    hash.Add(m_mesh != nullptr);
+                    return true;
+                }
+
+                size_t GetNumInstanceTargets() override { return m_ids.size(); }
+
+                RenderInstanceTarget *GetRenderInstanceTarget(size_t index) override
+                {
+                    // Legal, since a thread may only access one target at a time
+                    static thread_local MockInstanceTarget target;
+                    target.Set(this, index);
+                    return &target;
+                }
+
+                RenderInstanceTarget *GetRenderInstanceTargetInContext(size_t index, TargetContext &context) override
+                {
+                    // MockInstanceTarget is trivially destructible, so it can simply be rebuilt in place
+                    MockInstanceTarget *target = new (context.Storage()) MockInstanceTarget();
+                    target->Set(this, index);
+                    return target;
+                }
+
+                size_t GetTargetContextSize() override { return sizeof(MockInstanceTarget); }
+
+                size_t GetTMsBatch(size_t first, size_t count, int numSamples, Matrix3 *out) override
+                {
+                    count = ClampTargetRange(first, count);
+                    if (numSamples == m_numSamples)
+                    {
+                        memcpy(out, &m_tms[first * m_numSamples], sizeof(Matrix3) * count * m_numSamples);
+                        return count;
+                    }
+                    for (size_t i = 0; i < count; i++)
+                        for (int s = 0; s < numSamples; s++)
+                            out[i * numSamples + s] = m_tms[(first + i) * m_numSamples + NearestSample(s, numSamples, m_numSamples)];
+                    return count;
+                }
+
+                size_t GetMotionBatchSoA(size_t first, size_t count, Matrix3 *tms, Point3 *velocities, AngAxis *spins) override
+                {
+                    count = ClampTargetRange(first, count);
+                    if (tms)
+                        GetTMsBatch(first, count, 1, tms);
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        if (velocities) velocities[i] = m_velocities.empty() ? Point3(0.0f, 0.0f, 0.0f) : m_velocities[first + i];
+                        if (spins)      spins[i]      = m_spins.empty() ? AngAxis(Point3(0.0f, 0.0f, 1.0f), 0.0f) : m_spins[first + i];
+                    }
+                    return count;
+                }
+
+                bool GetChannelView(ChannelID channel, ChannelInfo::TypeID type, ChannelView &view) override
+                {
+                    if (channel < 0 || channel >= (int)m_channels.size() || m_channelTypes[channel] != type)
+                        return false;
+                    view.data   = m_channels[channel].data();
+                    view.stride = GetChannelTypeSize(type);
+                    view.count  = m_ids.size();
+                    return true;
+                }
+
+            private:
+                friend class MockInstanceTarget;
+                friend class MockInstancer;
+
+                Mesh                               *m_mesh = nullptr;
+                Box3                                m_bounds;
+                int                                 m_numSamples = 1;
+                std::vector<__int64>                m_ids;
+                std::vector<Matrix3>                m_tms;        //!< numSamples per target
+                std::vector<Point3>                 m_velocities;
+                std::vector<AngAxis>                m_spins;
+                std::vector<std::vector<char>>      m_channels;   //!< One contiguous array per ChannelID
+                std::vector<ChannelInfo::TypeID>    m_channelTypes;
+
+                template <typename T>
+                T GetChannelValue(ChannelID channel, size_t index, ChannelInfo::TypeID type, const T &def)
+                {
+                    if (channel < 0 || channel >= (int)m_channels.size() || m_channelTypes[channel] != type)
+                        return def;
+                    return ((const T*)m_channels[channel].data())[index];
+                }
+            };
+
+            inline void *MockInstanceTarget::GetCustomData(ChannelID channel)
+            {
+                if (channel < 0 || channel >= (int)m_source->m_channels.size())
+                    return nullptr;
+                return &m_source->m_channels[channel][m_index * GetChannelTypeSize(m_source->m_channelTypes[channel])];
+            }
+            inline float   MockInstanceTarget::GetCustomFloat (ChannelID channel) { return m_source->GetChannelValue(channel, m_index, ChannelInfo::typeFloat,  0.0f); }
+            inline Point3  MockInstanceTarget::GetCustomVector(ChannelID channel) { return m_source->GetChannelValue(channel, m_index, ChannelInfo::typeVector, Point3(0.0f, 0.0f, 0.0f)); }
+            inline Color   MockInstanceTarget::GetCustomColor (ChannelID channel) { return m_source->GetChannelValue(channel, m_index, ChannelInfo::typeColor,  Color(0.0f, 0.0f, 0.0f)); }
+            inline Matrix3 MockInstanceTarget::GetCustomTM    (ChannelID channel) { return m_source->GetChannelValue(channel, m_index, ChannelInfo::typeTM,     IdentityTM()); }
+
+            inline __int64 MockInstanceTarget::GetID()         { return m_source->m_ids[m_index]; }
+            inline __int64 MockInstanceTarget::GetInstanceID() { return m_source->m_ids[m_index] % 1000; }
+
+            inline MaxSDK::Array<Matrix3> MockInstanceTarget::GetTMs()
+            {
+                MaxSDK::Array<Matrix3> tms;
+                tms.setLengthUsed(m_source->m_numSamples);
+                for (int s = 0; s < m_source->m_numSamples; s++)
+                    tms[s] = m_source->m_tms[m_index * m_source->m_numSamples + s];
+                return tms;
+            }
+            inline Matrix3 MockInstanceTarget::GetTM()       { return m_source->m_tms[m_index * m_source->m_numSamples]; }
+            inline Point3  MockInstanceTarget::GetVelocity() { return m_source->m_velocities.empty() ? Point3(0.0f, 0.0f, 0.0f) : m_source->m_velocities[m_index]; }
+            inline AngAxis MockInstanceTarget::GetSpin()     { return m_source->m_spins.empty() ? AngAxis(Point3(0.0f, 0.0f, 1.0f), 0.0f) : m_source->m_spins[m_index]; }
+
+            inline bool    MockInstanceTarget::IsStatic()    { return m_source->m_numSamples == 1; }
+
+            /*! \brief A deterministic, configurable RenderTimeInstancing implementation */
+            class MockInstancer : public RenderTimeInstancing
+            {
+            public:
+                MockInstancer(const Config &config = Config()) : m_config(config) {}
+
+                void UpdateInstanceData(TimeValue t, Interval &valid, MotionBlurInfo &mbinfo, View &view, TSTR plugin) override
+                {
+                    Update(valid, mbinfo, 0);
+                }
+
+                void UpdateInstanceDataEx(TimeValue t, Interval &valid, MotionBlurInfo &mbinfo, UpdateInfo &updinfo, View &view, TSTR plugin) override
+                {
+                    updinfo.flags      = UpdateInfo::uf_none;
+                    updinfo.numSamples = Update(valid, mbinfo, updinfo.numSamples);
+                    updinfo.tmFormat   = UpdateInfo::tmf_matrix3;
+                    updinfo.numEmitted = m_stats.numEmitted;
+                    updinfo.numCulled  = 0;
+                }
+
+                void ReleaseInstanceData() override
+                {
+                    ScopedPhaseTimer timer(m_stats, InstancingStatistics::ph_release);
+                    ClearInstanceData();
+                }
+
+                bool RetainInstanceData(TimeValue t, Interval &valid) override
+                {
+                    // The scatter does not depend on time
+                    if (m_sources.empty())
+                        return false;
+                    valid = FOREVER;
+                    return true;
+                }
+
+                bool GetStatistics(InstancingStatistics &stats) override
+                {
+                    stats.seconds[InstancingStatistics::ph_update]  = m_stats.seconds[InstancingStatistics::ph_update];
+                    stats.seconds[InstancingStatistics::ph_release] = m_stats.seconds[InstancingStatistics::ph_release];
+                    stats.targetBytes  = m_stats.targetBytes;
+                    stats.channelBytes = m_stats.channelBytes;
+                    stats.numEmitted   = m_stats.numEmitted;
+                    return true;
+                }
+
+                MaxSDK::Array<ChannelInfo> GetChannels() override
+                {
+                    BuildChannels();
+                    return m_channelInfos;
+                }
+
+                ChannelID GetChannelID(TSTR name, TypeID type) override
+                {
+                    BuildChannels();
+                    for (size_t c = 0; c < m_channelInfos.length(); c++)
+                        if (m_channelInfos[c].name == name && (int)m_channelInfos[c].type == (int)type)
+                            return m_channelInfos[c].channelID;
+                    return -1;
+                }
+
+                size_t                GetNumInstanceSources()               override { return m_sources.size(); }
+                RenderInstanceSource *GetRenderInstanceSource(size_t index) override { return &m_sources[index]; }
+                ThreadingFlags        GetThreadingFlags()                   override { return th_concurrentSources; }
+
+                Capabilities GetCapabilities() override
+                {
+                    return (Capabilities)(cap_batchTMs | cap_motionBatch | cap_channelViews | cap_overrideViews
+                                          | cap_targetContext | cap_retain | cap_metadata | cap_statistics);
+                }
+
+            private:
+                Config                          m_config;
+                std::vector<MockInstanceSource> m_sources;
+                MaxSDK::Array<ChannelInfo>      m_channelInfos;
+                InstancingStatistics            m_stats;
+
+                //! Generate the scatter, with <em>requestedSamples</em> transforms per target if above 0. Returns the number used.
+                int Update(Interval &valid, MotionBlurInfo &mbinfo, int requestedSamples)
+                {
+                    // Not ReleaseInstanceData(), so that ph_release only counts explicit releases
+                    ScopedPhaseTimer timer(m_stats, InstancingStatistics::ph_update);
+                    ClearInstanceData();
+                    BuildChannels();
+
+                    bool  motionBlur = mbinfo.shutterInterval != NEVER && mbinfo.shutterInterval.Start() < mbinfo.shutterInterval.End();
+                    int   numSamples = requestedSamples > 0 ? requestedSamples : m_config.numMotionSamples;
+                    if (!motionBlur || numSamples < 1)
+                        numSamples = 1;
+                    float duration   = motionBlur ? (float)(mbinfo.shutterInterval.End() - mbinfo.shutterInterval.Start()) : 0.0f;
+
+                    mbinfo.flags = m_config.velocitySpin ? MotionBlurInfo::mb_velocityspin : MotionBlurInfo::mb_none;
+                    valid        = FOREVER;
+
+                    unsigned __int64 seed = 0x2545F4914F6CDD1DULL;
+                    __int64          id   = 0;
+                    m_sources.resize(m_config.numSources);
+                    for (auto &source : m_sources)
+                    {
+                        size_t num          = m_config.numTargetsPerSource;
+                        source.m_mesh       = m_config.mesh;
+                        source.m_numSamples = numSamples;
+                        source.m_bounds     = m_config.mesh ? m_config.mesh->getBoundingBox() : Box3(Point3(-1.0f, -1.0f, -1.0f), Point3(1.0f, 1.0f, 1.0f));
+                        source.m_ids.resize(num);
+                        source.m_tms.resize(num * numSamples);
+                        if (m_config.velocitySpin)
+                        {
+                            source.m_velocities.resize(num);
+                            source.m_spins.resize(num);
+                        }
+
+                        for (size_t i = 0; i < num; i++)
+                        {
+                            Point3 pos(Random(seed), Random(seed), Random(seed));
+                            Point3 vel(Random(seed), Random(seed), Random(seed));
+                            pos = pos * m_config.extent;
+                            vel = vel * 0.01f;
+                            float angle = Random(seed) * 3.14159265f;
+                            float spin  = Random(seed) * 0.001f;
+
+                            source.m_ids[i] = id++;
+                            if (m_config.velocitySpin)
+                            {
+                                source.m_velocities[i] = vel;
+                                source.m_spins[i]      = AngAxis(Point3(0.0f, 0.0f, 1.0f), spin);
+                            }
+                            for (int s = 0; s < numSamples; s++)
+                            {
+                                float dt = (numSamples > 1) ? duration * s / (numSamples - 1) : 0.0f;
+                                source.m_tms[i * numSamples + s] = MakeTM(pos + vel * dt, angle + spin * dt);
+                            }
+                        }
+
+                        source.m_channels.resize(m_channelInfos.length());
+                        source.m_channelTypes.resize(m_channelInfos.length());
+                        for (size_t c = 0; c < m_channelInfos.length(); c++)
+                        {
+                            ChannelInfo::TypeID type = m_channelInfos[c].type;
+                            size_t              size = GetChannelTypeSize(type);
+                            source.m_channelTypes[c] = type;
+                            source.m_channels[c].resize(num * size);
+                            char *values = source.m_channels[c].data();
+                            for (size_t v = 0; v < num; v++, values += size)
+                            {
+                                if (type == ChannelInfo::typeTM)
+                                    *(Matrix3*)values = MakeTM(Point3(Random(seed), Random(seed), Random(seed)), Random(seed));
+                                else
+                                    for (size_t f = 0; f < size / sizeof(float); f++)
+                                        ((float*)values)[f] = Random(seed);
+                            }
+                            m_stats.channelBytes += source.m_channels[c].size();
+                        }
+                        m_stats.targetBytes += num * (sizeof(__int64) + numSamples * sizeof(Matrix3));
+                        m_stats.targetBytes += source.m_velocities.size() * sizeof(Point3) + source.m_spins.size() * sizeof(AngAxis);
+                        m_stats.numEmitted  += num;
+                    }
+                    return numSamples;
+                }
+
+
+                void ClearInstanceData()
+                {
+                    m_sources.clear();
+                    m_stats.targetBytes = m_stats.channelBytes = 0;
+                    m_stats.numEmitted  = 0;
+                }
+
+                void BuildChannels()
+                {
+                    if (!m_channelInfos.isEmpty())
+                        return;
+                    AddChannels(_T("float"),  ChannelInfo::typeFloat,  m_config.numFloatChannels);
+                    AddChannels(_T("vector"), ChannelInfo::typeVector, m_config.numVectorChannels);
+                    AddChannels(_T("color"),  ChannelInfo::typeColor,  m_config.numColorChannels);
+                    AddChannels(_T("tm"),     ChannelInfo::typeTM,     m_config.numTMChannels);
+                }
+
+                void AddChannels(const TCHAR *prefix, ChannelInfo::TypeID type, int count)
+                {
+                    for (int i = 0; i < count; i++)
+                    {
+                        ChannelInfo info;
+                        info.name.printf(_T("%s%d"), prefix, i);
+                        info.type      = type;
+                        info.channelID = (ChannelID)m_channelInfos.length();
+                        info.size      = (int)GetChannelTypeSize(type);
+                        m_channelInfos.append(info);
+                    }
+                }
+
+                //! Uniform random number in [-1, 1), using xorshift64*
+                static float Random(unsigned __int64 &state)
+                {
+                    state ^= state >> 12;
+                    state ^= state << 25;
+                    state ^= state >> 27;
+                    return (float)((state * 0x2545F4914F6CDD1DULL) >> 40) / (float)(1 << 23) - 1.0f;
+                }
+
+                static Matrix3 MakeTM(const Point3 &pos, float angle)
+                {
+                    Matrix3 tm = IdentityTM();
+                    float c = cosf(angle), s = sinf(angle);
+                    tm.SetRow(0, Point3(   c,    s, 0.0f));
+                    tm.SetRow(1, Point3(  -s,    c, 0.0f));
+                    tm.SetRow(2, Point3(0.0f, 0.0f, 1.0f));
+                    tm.SetRow(3, pos);
+                    return tm;
+                }
+            };
+
+            /*! \name Benchmarks
+
+            Each benchmark traverses all targets of all sources of an instancer on which
+            UpdateInstanceData() has already been called, and returns the throughput. Apart from
+            BenchmarkIteration(), BenchmarkGetTMs(), BenchmarkVelocitySpin() and BenchmarkCustomChannels(),
+            they call the extended functions, so the instancer must have been obtained with
+            GetExtendedRenderTimeInstancing(). The
+            values read are accumulated into BenchmarkResult::checksum, so the compiler cannot
+            optimize the reads away, and so that different access paths can be checked to
+            return the same data.
+            */
+            ///@{
+            /*! \brief The result of a benchmark */
+            struct BenchmarkResult {
+                const TCHAR *name;         //!< \brief Name of the benchmark
+                size_t       numInstances; //!< \brief Number of targets traversed
+                double       seconds;      //!< \brief Wall time taken
+                double       checksum;     //!< \brief Sum of values read
+
+                double InstancesPerSecond() const { return seconds > 0.0 ? numInstances / seconds : 0.0; }
+            };
+
+            /*! \brief Time <em>func(RenderInstanceSource*, double &checksum)</em> over all sources.
+                <em>func</em> returns the number of targets it traversed. */
+            template <typename Func>
+            BenchmarkResult RunBenchmark(const TCHAR *name, RenderTimeInstancing &instancer, Func func)
+            {
+                BenchmarkResult result = { name, 0, 0.0, 0.0 };
+                auto start = std::chrono::steady_clock::now();
+                for (auto source : instancer)
+                    result.numInstances += func(source, result.checksum);
+                result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                return result;
+            }
+
+            /*! \brief Sequential iteration using the iterators, reading only GetID() */
+            inline BenchmarkResult BenchmarkIteration(RenderTimeInstancing &instancer)
+            {
+                return RunBenchmark(_T("Iteration"), instancer, [](RenderInstanceSource *source, double &sum)
+                {
+                    for (auto target : *source)
+                        sum += (double)target->GetID();
+                    return source->GetNumInstanceTargets();
+                });
+            }
+
+            /*! \brief Sequential iteration reading RenderInstanceTarget::GetTMs() */
+            inline BenchmarkResult BenchmarkGetTMs(RenderTimeInstancing &instancer)
+            {
+                return RunBenchmark(_T("GetTMs"), instancer, [](RenderInstanceSource *source, double &sum)
+                {
+                    for (auto target : *source)
+                    {
+                        auto tms = target->GetTMs();
+                        sum += tms[0].GetRow(3).x;
+                    }
+                    return source->GetNumInstanceTargets();
+                });
+            }
+
+            /*! \brief Sequential iteration reading GetTM(), GetVelocity() and GetSpin() */
+            inline BenchmarkResult BenchmarkVelocitySpin(RenderTimeInstancing &instancer)
+            {
+                return RunBenchmark(_T("GetTM+GetVelocity+GetSpin"), instancer, [](RenderInstanceSource *source, double &sum)
+                {
+                    for (auto target : *source)
+                    {
+                        Matrix3 tm   = target->GetTM();
+                        Point3  vel  = target->GetVelocity();
+                        AngAxis spin = target->GetSpin();
+                        sum += tm.GetRow(3).x + vel.x + spin.angle;
+                    }
+                    return source->GetNumInstanceTargets();
+                });
+            }
+
+            /*! \brief Sequential iteration reading every custom channel through the GetCustomXXX() functions */
+            inline BenchmarkResult BenchmarkCustomChannels(RenderTimeInstancing &instancer)
+            {
+                MaxSDK::Array<ChannelInfo> channels = instancer.GetChannels();
+                return RunBenchmark(_T("GetCustomXXX"), instancer, [&channels](RenderInstanceSource *source, double &sum)
+                {
+                    for (auto target : *source)
+                    {
+                        for (size_t c = 0; c < channels.length(); c++)
+                        {
+                            ChannelID id = channels[c].channelID;
+                            switch (channels[c].type)
+                            {
+                                case ChannelInfo::typeFloat:  sum += target->GetCustomFloat(id);          break;
+                                case ChannelInfo::typeVector: sum += target->GetCustomVector(id).x;       break;
+                                case ChannelInfo::typeColor:  sum += target->GetCustomColor(id).r;        break;
+                                case ChannelInfo::typeTM:     sum += target->GetCustomTM(id).GetRow(0).x; break;
+                                default: break;
+                            }
+                        }
+                    }
+                    return source->GetNumInstanceTargets();
+                });
+            }
+
+            /*! \brief Reading transform, velocity and spin in chunks through RenderInstanceSource::GetMotionBatch() */
+            inline BenchmarkResult BenchmarkMotionBatch(RenderTimeInstancing &instancer, size_t chunkSize = 4096)
+            {
+                std::vector<TargetMotion> buffer(chunkSize);
+                return RunBenchmark(_T("GetMotionBatch"), instancer, [&](RenderInstanceSource *source, double &sum)
+                {
+                    size_t num = source->GetNumInstanceTargets();
+                    for (size_t first = 0; first < num; first += chunkSize)
+                    {
+                        size_t count = source->GetMotionBatch(first, chunkSize, buffer.data());
+                        for (size_t i = 0; i < count; i++)
+                            sum += buffer[i].tm.GetRow(3).x + buffer[i].velocity.x + buffer[i].spin.angle;
+                    }
+                    return num;
+                });
+            }
+
+            /*! \brief Reading transforms in chunks through RenderInstanceSource::GetTMsBatch() */
+            inline BenchmarkResult BenchmarkTMsBatch(RenderTimeInstancing &instancer, int numSamples = 2, size_t chunkSize = 4096)
+            {
+                std::vector<Matrix3> buffer(chunkSize * numSamples);
+                return RunBenchmark(_T("GetTMsBatch"), instancer, [&](RenderInstanceSource *source, double &sum)
+                {
+                    size_t num = source->GetNumInstanceTargets();
+                    for (size_t first = 0; first < num; first += chunkSize)
+                    {
+                        size_t count = source->GetTMsBatch(first, chunkSize, numSamples, buffer.data());
+                        for (size_t i = 0; i < count; i++)
+                            sum += buffer[i * numSamples].GetRow(3).x;
+                    }
+                    return num;
+                });
+            }
+
+            /*! \brief Reading every custom channel in chunks through RenderInstanceSource::GetChannelBatch() */
+            inline BenchmarkResult BenchmarkChannelBatch(RenderTimeInstancing &instancer, size_t chunkSize = 4096)
+            {
+                MaxSDK::Array<ChannelInfo> channels = instancer.GetChannels();
+                std::vector<Matrix3>       buffer(chunkSize);
+                return RunBenchmark(_T("GetChannelBatch"), instancer, [&](RenderInstanceSource *source, double &sum)
+                {
+                    size_t num = source->GetNumInstanceTargets();
+                    for (size_t c = 0; c < channels.length(); c++)
+                    {
+                        // Same components as BenchmarkCustomChannels(), so the sums can be compared
+                        ChannelInfo::TypeID type = channels[c].type;
+                        if (type != ChannelInfo::typeFloat && type != ChannelInfo::typeVector &&
+                            type != ChannelInfo::typeColor && type != ChannelInfo::typeTM)
+                            continue;
+                        for (size_t first = 0; first < num; first += chunkSize)
+                        {
+                            size_t count = source->GetChannelBatch(channels[c].channelID, type, first, chunkSize,
+                                                                   buffer.data(), sizeof(Matrix3));
+                            for (size_t i = 0; i < count; i++)
+                            {
+                                const Matrix3 &value = buffer[i];
+                                switch (type)
+                                {
+                                    case ChannelInfo::typeFloat:  sum += *(const float*)&value;      break;
+                                    case ChannelInfo::typeVector: sum += ((const Point3*)&value)->x; break;
+                                    case ChannelInfo::typeColor:  sum += ((const Color*)&value)->r;  break;
+                                    case ChannelInfo::typeTM:     sum += value.GetRow(0).x;          break;
+                                    default: break;
+                                }
+                            }
+                        }
+                    }
+                    return num;
+                });
+            }
+
+            /*! \brief Parallel iteration using ForEachTargetRange(), reading RenderInstanceTarget::GetTM().
+                Each range sums into its own slot, and the slots are added in order, so the checksum does not
+                depend on the thread timing. */
+            inline BenchmarkResult BenchmarkParallelIteration(RenderTimeInstancing &instancer, size_t grainSize = 4096)
+            {
+                if (grainSize == 0)
+                    grainSize = 1;
+                std::vector<double> partialSums;
+                return RunBenchmark(_T("ForEachTargetRange"), instancer, [grainSize, &partialSums](RenderInstanceSource *source, double &sum)
+                {
+                    size_t num = source->GetNumInstanceTargets();
+                    partialSums.assign((num + grainSize - 1) / grainSize, 0.0);
+                    ForEachTargetRange(source, grainSize, [&partialSums, grainSize](TargetRange &range)
+                    {
+                        double partial = 0.0;
+                        for (auto target : range)
+                            partial += target->GetTM().GetRow(3).x;
+                        partialSums[range.first() / grainSize] = partial;
+                    }, 0, true);
+                    for (double partial : partialSums)
+                        sum += partial;
+                    return num;
+                });
+            }
+            ///@}
+        }
+    }
+}